@@ -0,0 +1,32 @@
+#include "accumulate.h"
+#include <algorithm>
+#include <stdexcept>
+
+double accumulateStep(Module &model, Optimizer &optimizer, size_t batch_size, size_t micro_batch_size, const std::function<std::shared_ptr<Value>(size_t)> &sample_loss)
+{
+    if (batch_size == 0 || micro_batch_size == 0)
+    {
+        throw std::invalid_argument("accumulateStep: batch sizes must be positive");
+    }
+
+    model.zero_grad();
+    std::shared_ptr<Value> scale = std::make_shared<Value>(static_cast<double>(batch_size));
+    double total = 0.0;
+
+    for (size_t begin = 0; begin < batch_size; begin += micro_batch_size)
+    {
+        size_t end = std::min(batch_size, begin + micro_batch_size);
+
+        std::shared_ptr<Value> loss = std::make_shared<Value>(0.0);
+        for (size_t i = begin; i < end; ++i)
+        {
+            loss = loss + sample_loss(i);
+        }
+        loss = loss / scale;
+        loss->backward();
+        total += loss->data;
+    }
+
+    optimizer.step();
+    return total;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <functional>
+#include "nn.h"
+#include "optimizer.h"
+
+// One optimizer step over a logical batch of batch_size samples, run as micro-batches of
+// micro_batch_size. Each micro-batch builds its graph, backpropagates into the parameter
+// grads and is freed before the next one, so peak graph memory depends on the micro-batch
+// only. Losses are divided by batch_size, so the grads equal those of the full batch mean.
+// sample_loss(i) returns the loss of sample i; the mean loss of the batch is returned.
+double accumulateStep(Module &model, Optimizer &optimizer, size_t batch_size, size_t micro_batch_size, const std::function<std::shared_ptr<Value>(size_t)> &sample_loss);
@@ -0,0 +1,339 @@
+#include "codegen.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    std::string literal(double x)
+    {
+        std::ostringstream out;
+        out << std::hexfloat << x;
+        return "(" + out.str() + ")";
+    }
+
+    std::string valueName(const Trace &trace, int i)
+    {
+        const Trace::Node &node = trace.nodes.at(i);
+        switch (node.leaf)
+        {
+        case Trace::Leaf::Parameter:
+            return "p[" + std::to_string(node.index) + "]";
+        case Trace::Leaf::Input:
+            return "x[" + std::to_string(node.index) + "]";
+        case Trace::Leaf::Constant:
+            return literal(trace.constants.at(node.index));
+        default:
+            return "v" + std::to_string(i);
+        }
+    }
+
+    // Empty for leaves whose gradient isn't needed
+    std::string gradName(const Trace &trace, int i)
+    {
+        const Trace::Node &node = trace.nodes.at(i);
+        if (node.leaf == Trace::Leaf::Parameter)
+        {
+            return "dp[" + std::to_string(node.index) + "]";
+        }
+        return node.leaf == Trace::Leaf::None ? "g" + std::to_string(i) : "";
+    }
+
+    std::string forwardExpression(const Trace::Node &node, const std::string &a, const std::string &b)
+    {
+        switch (node.op)
+        {
+        case Op::Add:
+            return a + " + " + b;
+        case Op::Sub:
+            return a + " - " + b;
+        case Op::Mul:
+            return a + " * " + b;
+        case Op::Div:
+            return a + " / " + b;
+        case Op::Pow:
+            return "std::pow(" + a + ", " + b + ")";
+        case Op::Max:
+            return a + " > " + b + " ? " + a + " : " + b;
+        case Op::Min:
+            return a + " > " + b + " ? " + b + " : " + a;
+        case Op::Neg:
+            return "-" + a;
+        case Op::Exp:
+            return "std::exp(" + a + ")";
+        case Op::Sqrt:
+            return "std::sqrt(" + a + ")";
+        case Op::Log:
+            return "std::log(" + a + ")";
+        case Op::Tanh:
+            return "std::tanh(" + a + ")";
+        case Op::Relu:
+            return a + " < 0.0 ? 0.0 : " + a;
+        case Op::Sigmoid:
+            return "1.0 / (1.0 + std::exp(-" + a + "))";
+        case Op::LeakyRelu:
+            return a + " < 0.0 ? " + literal(node.param) + " * " + a + " : " + a;
+        case Op::Pos:
+        case Op::Id:
+            return a;
+        default:
+            throw std::invalid_argument("codegen: unsupported op");
+        }
+    }
+
+    // Contributions to the operands' gradients, g is the node's own gradient and y its value
+    std::pair<std::string, std::string> backwardExpressions(const Trace::Node &node, const std::string &a, const std::string &b, const std::string &y)
+    {
+        switch (node.op)
+        {
+        case Op::Add:
+            return {"g", "g"};
+        case Op::Sub:
+            return {"g", "-g"};
+        case Op::Mul:
+            return {"g * " + b, "g * " + a};
+        case Op::Div:
+            return {"g / " + b, "-g * " + a + " / (" + b + " * " + b + ")"};
+        case Op::Pow:
+            return {"g * " + b + " * std::pow(" + a + ", " + b + " - 1.0)", "g * " + y + " * std::log(" + a + ")"};
+        case Op::Max:
+            return {a + " > " + b + " ? g : 0.0", a + " > " + b + " ? 0.0 : g"};
+        case Op::Min:
+            return {a + " > " + b + " ? 0.0 : g", a + " > " + b + " ? g : 0.0"};
+        case Op::Neg:
+            return {"-g", ""};
+        case Op::Exp:
+            return {"g * " + y, ""};
+        case Op::Sqrt:
+            return {"g / (2.0 * " + y + ")", ""};
+        case Op::Log:
+            return {"g / " + a, ""};
+        case Op::Tanh:
+            return {"g * (1.0 - " + y + " * " + y + ")", ""};
+        case Op::Relu:
+            return {a + " < 0.0 ? 0.0 : g", ""};
+        case Op::Sigmoid:
+            return {"g * " + y + " * (1.0 - " + y + ")", ""};
+        case Op::LeakyRelu:
+            return {a + " < 0.0 ? g * " + literal(node.param) + " : g", ""};
+        default: // Pos, Id
+            return {"g", ""};
+        }
+    }
+
+    void emitForward(std::ostream &out, const Trace &trace)
+    {
+        for (size_t i = 0; i < trace.nodes.size(); ++i)
+        {
+            const Trace::Node &node = trace.nodes.at(i);
+            if (node.op == Op::Leaf)
+            {
+                continue;
+            }
+            std::string a = valueName(trace, node.a);
+            std::string b = node.b < 0 ? "" : valueName(trace, node.b);
+            out << "    const double v" << i << " = " << forwardExpression(node, a, b) << ";\n";
+        }
+    }
+
+    // Seeds the outputs' gradients from dy[] and accumulates dL/dp into dp[]
+    void emitBackward(std::ostream &out, const Trace &trace)
+    {
+        for (size_t i = 0; i < trace.nodes.size(); ++i)
+        {
+            if (trace.nodes.at(i).op != Op::Leaf)
+            {
+                out << "    double g" << i << " = 0.0;\n";
+            }
+        }
+        for (size_t i = 0; i < trace.outputs.size(); ++i)
+        {
+            std::string g = gradName(trace, trace.outputs.at(i));
+            if (!g.empty())
+            {
+                out << "    " << g << " += dy[" << i << "];\n";
+            }
+        }
+        for (size_t i = trace.nodes.size(); i-- > 0;)
+        {
+            const Trace::Node &node = trace.nodes.at(i);
+            if (node.op == Op::Leaf)
+            {
+                continue;
+            }
+            std::string a = valueName(trace, node.a);
+            std::string b = node.b < 0 ? "" : valueName(trace, node.b);
+            auto [da, db] = backwardExpressions(node, a, b, "v" + std::to_string(i));
+            std::string ga = gradName(trace, node.a);
+            std::string gb = node.b < 0 ? "" : gradName(trace, node.b);
+            if (ga.empty() && gb.empty())
+            {
+                continue;
+            }
+            out << "    {\n        const double g = g" << i << ";\n";
+            if (!ga.empty())
+            {
+                out << "        " << ga << " += " << da << ";\n";
+            }
+            if (!gb.empty() && !db.empty())
+            {
+                out << "        " << gb << " += " << db << ";\n";
+            }
+            out << "    }\n";
+        }
+    }
+}
+
+std::string generateSource(const Trace &trace, const CodegenOptions &options)
+{
+    std::ostringstream out;
+    size_t num_parameters = trace.parameters.size();
+    size_t num_outputs = trace.outputs.size();
+
+    out << "// Generated by micrograd codegen from a traced graph, don't edit.\n";
+    out << "// Build: c++ -std=c++17 -O3 -march=native <this file>\n";
+    out << "#include <cmath>\n#include <cstddef>\n";
+    if (options.benchmark_main)
+    {
+        out << "#include <chrono>\n#include <cstdio>\n#include <vector>\n";
+    }
+    out << "\nnamespace " << options.name << "\n{\n";
+    out << "constexpr std::size_t num_parameters = " << num_parameters << ";\n";
+    out << "constexpr std::size_t num_inputs = " << trace.num_inputs << ";\n";
+    out << "constexpr std::size_t num_outputs = " << num_outputs << ";\n\n";
+
+    out << "// Parameters at trace time\n";
+    out << "const double trained_parameters[num_parameters + 1] = {";
+    for (size_t i = 0; i < num_parameters; ++i)
+    {
+        out << (i % 4 ? " " : "\n    ") << literal(trace.parameters.at(i)->data) << ",";
+    }
+    out << "\n    0.0};\n\n";
+
+    out << "inline void forward(const double *p, const double *x, double *y)\n{\n";
+    emitForward(out, trace);
+    for (size_t i = 0; i < num_outputs; ++i)
+    {
+        out << "    y[" << i << "] = " << valueName(trace, trace.outputs.at(i)) << ";\n";
+    }
+    out << "}\n\n";
+
+    out << "// Adds dL/dp for the given dL/dy into dp\n";
+    out << "inline void forward_backward(const double *p, const double *x, const double *dy, double *y, double *dp)\n{\n";
+    emitForward(out, trace);
+    for (size_t i = 0; i < num_outputs; ++i)
+    {
+        out << "    y[" << i << "] = " << valueName(trace, trace.outputs.at(i)) << ";\n";
+    }
+    emitBackward(out, trace);
+    out << "}\n\n";
+
+    out << "// Softmax cross entropy on the outputs in one pass: forward, dL/dy from the values just\n";
+    out << "// computed, then backward. Adds scale * dL/dp into dp and returns the loss\n";
+    out << "inline double train_sample(const double *p, const double *x, std::size_t truth, double *dp, double scale = 1.0)\n{\n";
+    emitForward(out, trace);
+    out << "    const double y[num_outputs] = {";
+    for (size_t i = 0; i < num_outputs; ++i)
+    {
+        out << (i ? ", " : "") << valueName(trace, trace.outputs.at(i));
+    }
+    out << "};\n";
+    out << R"(    double dy[num_outputs];
+    double y_max = y[0];
+    for (std::size_t i = 1; i < num_outputs; ++i)
+    {
+        y_max = y[i] > y_max ? y[i] : y_max;
+    }
+    double sum = 0.0;
+    for (std::size_t i = 0; i < num_outputs; ++i)
+    {
+        dy[i] = std::exp(y[i] - y_max);
+        sum += dy[i];
+    }
+    for (std::size_t i = 0; i < num_outputs; ++i)
+    {
+        dy[i] = scale * dy[i] / sum;
+    }
+    dy[truth] -= scale;
+)";
+    emitBackward(out, trace);
+    out << R"(    return -y[truth] + y_max + std::log(sum);
+}
+
+inline void sgd_step(double *p, double *dp, double *velocities, double learning_rate, double weight_decay = 0.0, double rho = 0.0)
+{
+    for (std::size_t i = 0; i < num_parameters; ++i)
+    {
+        velocities[i] = rho * velocities[i] + dp[i];
+        p[i] -= learning_rate * (velocities[i] + weight_decay * p[i]);
+        dp[i] = 0.0;
+    }
+}
+
+inline void adam_step(double *p, double *dp, double *moment1, double *moment2, long t, double learning_rate, double weight_decay = 0.0, double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-7)
+{
+    double correction1 = 1.0 - std::pow(beta1, t);
+    double correction2 = 1.0 - std::pow(beta2, t);
+    for (std::size_t i = 0; i < num_parameters; ++i)
+    {
+        moment1[i] = beta1 * moment1[i] + (1.0 - beta1) * dp[i];
+        moment2[i] = beta2 * moment2[i] + (1.0 - beta2) * dp[i] * dp[i];
+        p[i] -= learning_rate * ((moment1[i] / correction1) / (std::sqrt(moment2[i] / correction2) + epsilon) + weight_decay * p[i]);
+        dp[i] = 0.0;
+    }
+}
+}
+)";
+
+    if (options.benchmark_main)
+    {
+        out << "\nint main()\n{\n";
+        out << "    using namespace " << options.name << ";\n";
+        out << R"(    std::vector<double> p(trained_parameters, trained_parameters + num_parameters);
+    std::vector<double> dp(num_parameters, 0.0);
+    std::vector<double> x(num_inputs, 0.0);
+    const std::size_t samples = 100000;
+    unsigned long long state = 42;
+    double loss = 0.0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t s = 0; s < samples; ++s)
+    {
+        for (std::size_t i = 0; i < num_inputs; ++i)
+        {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            x[i] = static_cast<double>(state >> 11) * 0x1.0p-53;
+        }
+        loss += train_sample(p.data(), x.data(), s % num_outputs, dp.data(), 1.0 / samples);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / samples;
+
+    std::printf("forward+backward : %.1f ns/sample, avg loss %.6f\n", ns, loss / samples);
+    return 0;
+}
+)";
+    }
+
+    return out.str();
+}
+
+void writeSource(const Trace &trace, const std::string &path, const CodegenOptions &options)
+{
+    std::filesystem::path file(path);
+    if (file.has_parent_path())
+    {
+        std::filesystem::create_directories(file.parent_path());
+    }
+    std::ofstream out(file);
+    if (!out)
+    {
+        throw std::runtime_error("codegen: can't write " + path);
+    }
+    out << generateSource(trace, options);
+}
+
+std::string compileCommand(const std::string &source, const std::string &binary)
+{
+    return "c++ -std=c++17 -O3 -march=native " + source + " -o " + binary;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <string>
+#include "trace.h"
+
+struct CodegenOptions
+{
+    std::string name = "model"; // namespace of the generated kernels
+    bool benchmark_main = false; // emit a main() timing forward_backward on synthetic inputs
+};
+
+// Emits a traced graph as one dependency-free C++ source: forward and forward_backward as
+// straight-line code over plain double arrays, a softmax cross-entropy train_sample doing
+// forward, loss and backward in one pass, SGD and Adam steps, and the parameters as they were
+// when traced.
+std::string generateSource(const Trace &trace, const CodegenOptions &options = {});
+void writeSource(const Trace &trace, const std::string &path, const CodegenOptions &options = {});
+std::string compileCommand(const std::string &source, const std::string &binary);
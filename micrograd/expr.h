@@ -0,0 +1,375 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include "value.h"
+#include "ops.h"
+
+// Lazy elementwise expressions: once an operand is wrapped with expr::lazy, the operators
+// and functions below build an expression type instead of one Value per operator. Converting
+// the expression to std::shared_ptr<Value> evaluates it into a single fused node whose
+// backward pushes the gradient through the whole chain at once, with the node, expression and
+// leaves in a single allocation. Fused nodes don't track grad2.
+// While an Unfused guard is alive expressions lower to the plain ops instead, so graph tracers
+// only ever see primitive nodes.
+//
+//   std::shared_ptr<Value> loss = -expr::lazy(pred) + logits_max + log_sum;
+namespace expr
+{
+    inline thread_local bool unfused = false;
+
+    struct Unfused
+    {
+        bool previous;
+        Unfused() : previous(unfused) { unfused = true; }
+        ~Unfused() { unfused = previous; }
+    };
+
+    struct Tag
+    {
+    };
+
+    template <typename E>
+    constexpr bool is_expr_v = std::is_base_of_v<Tag, E>;
+
+    template <typename D>
+    struct Expr : Tag
+    {
+        operator std::shared_ptr<Value>() const;
+    };
+
+    struct Var : Expr<Var>
+    {
+        static constexpr size_t num_leaves = 1;
+        std::shared_ptr<Value> value;
+
+        explicit Var(std::shared_ptr<Value> value) : value(std::move(value)) {}
+        double eval() const { return value->data; }
+        void backward(double grad) const { value->grad += grad; }
+        std::shared_ptr<Value> lower() const { return value; }
+        template <typename F>
+        void visit(F &f) const { f(value); }
+    };
+
+    struct Const : Expr<Const>
+    {
+        static constexpr size_t num_leaves = 0;
+        double c;
+
+        explicit Const(double c) : c(c) {}
+        double eval() const { return c; }
+        void backward(double) const {}
+        std::shared_ptr<Value> lower() const { return std::make_shared<Value>(c); }
+        template <typename F>
+        void visit(F &) const {}
+    };
+
+    template <typename T>
+    auto as_expr(const T &x)
+    {
+        if constexpr (is_expr_v<T>)
+        {
+            return x;
+        }
+        else if constexpr (std::is_arithmetic_v<T>)
+        {
+            return Const(static_cast<double>(x));
+        }
+        else
+        {
+            return Var(x);
+        }
+    }
+
+    template <typename T>
+    using expr_t = decltype(as_expr(std::declval<T>()));
+
+    inline Var lazy(const std::shared_ptr<Value> &value) { return Var(value); }
+
+    // Binary nodes cache their operand values during eval for backward
+    template <typename L, typename R, typename Op>
+    struct Binary : Expr<Binary<L, R, Op>>
+    {
+        static constexpr size_t num_leaves = L::num_leaves + R::num_leaves;
+        L l;
+        R r;
+        mutable double lv = 0.0;
+        mutable double rv = 0.0;
+
+        Binary(L l, R r) : l(std::move(l)), r(std::move(r)) {}
+        double eval() const
+        {
+            lv = l.eval();
+            rv = r.eval();
+            return Op::forward(lv, rv);
+        }
+        void backward(double grad) const
+        {
+            l.backward(grad * Op::dl(lv, rv));
+            r.backward(grad * Op::dr(lv, rv));
+        }
+        std::shared_ptr<Value> lower() const { return Op::apply(l.lower(), r.lower()); }
+        template <typename F>
+        void visit(F &f) const
+        {
+            l.visit(f);
+            r.visit(f);
+        }
+    };
+
+    // Unary nodes cache input and output during eval for backward
+    template <typename A, typename Op>
+    struct Unary : Expr<Unary<A, Op>>
+    {
+        static constexpr size_t num_leaves = A::num_leaves;
+        A a;
+        mutable double x = 0.0;
+        mutable double y = 0.0;
+
+        explicit Unary(A a) : a(std::move(a)) {}
+        double eval() const
+        {
+            x = a.eval();
+            y = Op::forward(x);
+            return y;
+        }
+        void backward(double grad) const { a.backward(grad * Op::derivative(x, y)); }
+        std::shared_ptr<Value> lower() const { return Op::apply(a.lower()); }
+        template <typename F>
+        void visit(F &f) const { a.visit(f); }
+    };
+
+    namespace op
+    {
+        struct Add
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a, const std::shared_ptr<Value> &b) { return ::operator+(a, b); }
+            static double forward(double a, double b) { return a + b; }
+            static double dl(double, double) { return 1.0; }
+            static double dr(double, double) { return 1.0; }
+        };
+        struct Sub
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a, const std::shared_ptr<Value> &b) { return ::operator-(a, b); }
+            static double forward(double a, double b) { return a - b; }
+            static double dl(double, double) { return 1.0; }
+            static double dr(double, double) { return -1.0; }
+        };
+        struct Mul
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a, const std::shared_ptr<Value> &b) { return ::operator*(a, b); }
+            static double forward(double a, double b) { return a * b; }
+            static double dl(double, double b) { return b; }
+            static double dr(double a, double) { return a; }
+        };
+        struct Div
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a, const std::shared_ptr<Value> &b) { return ::operator/(a, b); }
+            static double forward(double a, double b) { return a / b; }
+            static double dl(double, double b) { return 1.0 / b; }
+            static double dr(double a, double b) { return -a / (b * b); }
+        };
+        // No operation at all, for a dense node whose activation is applied separately
+        struct None
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a) { return a; }
+            static double forward(double x) { return x; }
+            static double derivative(double, double) { return 1.0; }
+        };
+        struct Id
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a) { return ::id(a); }
+            static double forward(double x) { return x; }
+            static double derivative(double, double) { return 1.0; }
+        };
+        struct Neg
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a) { return ::operator-(a); }
+            static double forward(double x) { return -x; }
+            static double derivative(double, double) { return -1.0; }
+        };
+        struct Exp
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a) { return ::exp(a); }
+            static double forward(double x) { return std::exp(x); }
+            static double derivative(double, double y) { return y; }
+        };
+        struct Log
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a) { return ::log(a); }
+            static double forward(double x) { return std::log(x); }
+            static double derivative(double x, double) { return 1.0 / x; }
+        };
+        struct Sqrt
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a) { return ::sqrt(a); }
+            static double forward(double x) { return std::sqrt(x); }
+            static double derivative(double, double y) { return 1.0 / (2.0 * y); }
+        };
+        struct Tanh
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a) { return ops::tanh(a); }
+            static double forward(double x) { return std::tanh(x); }
+            static double derivative(double, double y) { return 1.0 - y * y; }
+        };
+        struct Sigmoid
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a) { return ::sigmoid(a); }
+            static double forward(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+            static double derivative(double, double y) { return y * (1.0 - y); }
+        };
+        struct Relu
+        {
+            static std::shared_ptr<Value> apply(const std::shared_ptr<Value> &a) { return ::relu(a); }
+            static double forward(double x) { return (x < 0.0) ? 0.0 : x; }
+            static double derivative(double x, double) { return (x < 0.0) ? 0.0 : 1.0; }
+        };
+    }
+
+    template <typename A, typename B>
+    using enable_binary = std::enable_if_t<is_expr_v<A> || is_expr_v<B>>;
+
+    template <typename A>
+    using enable_unary = std::enable_if_t<is_expr_v<A>>;
+
+    template <typename A, typename B, typename = enable_binary<A, B>>
+    auto operator+(const A &a, const B &b) { return Binary<expr_t<A>, expr_t<B>, op::Add>(as_expr(a), as_expr(b)); }
+
+    template <typename A, typename B, typename = enable_binary<A, B>>
+    auto operator-(const A &a, const B &b) { return Binary<expr_t<A>, expr_t<B>, op::Sub>(as_expr(a), as_expr(b)); }
+
+    template <typename A, typename B, typename = enable_binary<A, B>>
+    auto operator*(const A &a, const B &b) { return Binary<expr_t<A>, expr_t<B>, op::Mul>(as_expr(a), as_expr(b)); }
+
+    template <typename A, typename B, typename = enable_binary<A, B>>
+    auto operator/(const A &a, const B &b) { return Binary<expr_t<A>, expr_t<B>, op::Div>(as_expr(a), as_expr(b)); }
+
+    template <typename A, typename = enable_unary<A>>
+    auto operator-(const A &a) { return Unary<A, op::Neg>(a); }
+
+    template <typename A, typename = enable_unary<A>>
+    auto exp(const A &a) { return Unary<A, op::Exp>(a); }
+
+    template <typename A, typename = enable_unary<A>>
+    auto log(const A &a) { return Unary<A, op::Log>(a); }
+
+    template <typename A, typename = enable_unary<A>>
+    auto sqrt(const A &a) { return Unary<A, op::Sqrt>(a); }
+
+    template <typename A, typename = enable_unary<A>>
+    auto tanh(const A &a) { return Unary<A, op::Tanh>(a); }
+
+    template <typename A, typename = enable_unary<A>>
+    auto sigmoid(const A &a) { return Unary<A, op::Sigmoid>(a); }
+
+    template <typename A, typename = enable_unary<A>>
+    auto relu(const A &a) { return Unary<A, op::Relu>(a); }
+
+    // One allocation holding the node, its expression and its leaves, so fusing needs neither a
+    // std::function nor an operand vector
+    template <typename E>
+    struct FusedValue : Value
+    {
+        E e;
+        std::array<std::shared_ptr<Value>, E::num_leaves> leaves;
+
+        explicit FusedValue(const E &expression) : Value(expression.eval()), e(expression)
+        {
+            size_t n = 0;
+            auto add = [this, &n](const std::shared_ptr<Value> &leaf)
+            { leaves[n++] = leaf; };
+            e.visit(add);
+
+            op = Op::Fused;
+            operands = leaves.data();
+            num_operands = leaves.size();
+            fused_backward = [](Value &self)
+            {
+                static_cast<FusedValue &>(self).e.backward(self.grad);
+            };
+        }
+    };
+
+    // Evaluates the expression into one node whose operands are the expression's leaves
+    template <typename E, typename = enable_unary<E>>
+    std::shared_ptr<Value> fuse(const E &e)
+    {
+        return std::make_shared<FusedValue<E>>(e);
+    }
+
+    // act(sum_i x[i] * w[i] + b) as one node with operands x..., w..., b. Its leaf count is only
+    // known at run time, so they take one vector next to the node.
+    template <typename Act>
+    struct DenseValue : Value
+    {
+        size_t dim_in;
+        double z; // before the activation
+        std::vector<std::shared_ptr<Value>> leaves;
+
+        DenseValue(const std::vector<std::shared_ptr<Value>> &x, const std::vector<std::shared_ptr<Value>> &w, const std::shared_ptr<Value> &b)
+            : Value(0.0), dim_in(w.size())
+        {
+            leaves.reserve(2 * dim_in + 1);
+            leaves.insert(leaves.end(), x.begin(), x.begin() + dim_in);
+            leaves.insert(leaves.end(), w.begin(), w.end());
+            leaves.emplace_back(b);
+
+            // Same summation order as the unfused chain, so results match bit for bit
+            double sum = 0.0;
+            for (size_t i = 0; i < dim_in; ++i)
+            {
+                sum = sum + x[i]->data * w[i]->data;
+            }
+            z = sum + b->data;
+            data = Act::forward(z);
+
+            op = Op::Fused;
+            operands = leaves.data();
+            num_operands = leaves.size();
+            fused_backward = [](Value &self)
+            {
+                auto &node = static_cast<DenseValue &>(self);
+                double g = node.grad * Act::derivative(node.z, node.data);
+                for (size_t i = 0; i < node.dim_in; ++i)
+                {
+                    node.leaves[i]->grad += g * node.leaves[node.dim_in + i]->data;
+                    node.leaves[node.dim_in + i]->grad += g * node.leaves[i]->data;
+                }
+                node.leaves.back()->grad += g;
+            };
+        }
+    };
+
+    // x may be longer than w, only its first w.size() entries are read. While unfused this
+    // lowers to the plain ops, one Value per operator.
+    template <typename Act>
+    std::shared_ptr<Value> dense(const std::vector<std::shared_ptr<Value>> &x, const std::vector<std::shared_ptr<Value>> &w, const std::shared_ptr<Value> &b)
+    {
+        if (unfused)
+        {
+            std::shared_ptr<Value> sum = std::make_shared<Value>(0.0);
+            for (size_t i = 0; i < w.size(); ++i)
+            {
+                sum = ::operator+(sum, ::operator*(x.at(i), w.at(i)));
+            }
+            return Act::apply(::operator+(sum, b));
+        }
+        if (x.size() < w.size())
+        {
+            throw std::out_of_range("expr::dense: input shorter than weights");
+        }
+        return std::make_shared<DenseValue<Act>>(x, w, b);
+    }
+
+    template <typename D>
+    Expr<D>::operator std::shared_ptr<Value>() const
+    {
+        if (unfused)
+        {
+            return static_cast<const D &>(*this).lower();
+        }
+        return fuse(static_cast<const D &>(*this));
+    }
+}
@@ -22,4 +22,37 @@ std::vector<std::shared_ptr<Value>> concate(const std::vector<std::shared_ptr<Va
     res.insert(res.end(), a.begin(), a.end());
     res.insert(res.end(), b.begin(), b.end());
     return res;
-}
\ No newline at end of file
+}
+
+void encodeName(const std::string &name, const std::unordered_map<char, int> &ctoi, size_t context, std::vector<int> &examples)
+{
+    std::string padded = "." + name + ".";
+    for (size_t i = 0; i + context < padded.length(); ++i)
+    {
+        for (size_t j = 0; j <= context; ++j)
+        {
+            examples.emplace_back(ctoi.at(padded[i + j]));
+        }
+    }
+}
+
+std::vector<std::shared_ptr<Value>> encodeInput(const int *example, size_t context, size_t num_classes)
+{
+    std::vector<std::shared_ptr<Value>> x;
+    x.reserve(context * num_classes);
+    for (size_t j = 0; j < context; ++j)
+    {
+        std::vector<std::shared_ptr<Value>> code = one_hot(std::make_shared<Value>(example[j]), num_classes);
+        x.insert(x.end(), code.begin(), code.end());
+    }
+    return x;
+}
+
+void encodeInput(const int *example, size_t context, size_t num_classes, std::vector<double> &x)
+{
+    x.assign(context * num_classes, 0.0);
+    for (size_t j = 0; j < context; ++j)
+    {
+        x.at(j * num_classes + example[j]) = 1.0;
+    }
+}
@@ -1,5 +1,17 @@
+#pragma once
+#include <string>
+#include <unordered_map>
 #include <value.h>
 
 std::vector<std::shared_ptr<Value>> one_hot(const std::shared_ptr<Value> &value, const size_t &num_classes);
 
-std::vector<std::shared_ptr<Value>> concate(const std::vector<std::shared_ptr<Value>> &a, const std::vector<std::shared_ptr<Value>> &b);
\ No newline at end of file
+std::vector<std::shared_ptr<Value>> concate(const std::vector<std::shared_ptr<Value>> &a, const std::vector<std::shared_ptr<Value>> &b);
+
+// Appends every window of the '.'-padded name as context indices followed by the target index
+void encodeName(const std::string &name, const std::unordered_map<char, int> &ctoi, size_t context, std::vector<int> &examples);
+
+// One-hot input of an encoded example, num_classes values per context index
+std::vector<std::shared_ptr<Value>> encodeInput(const int *example, size_t context, size_t num_classes);
+
+// Same into a reused buffer, which allocates only the first time
+void encodeInput(const int *example, size_t context, size_t num_classes, std::vector<double> &x);
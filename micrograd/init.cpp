@@ -0,0 +1,182 @@
+#include "init.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+std::array<uint32_t, 4> Philox::generate(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key)
+{
+    constexpr uint64_t M0 = 0xD2511F53;
+    constexpr uint64_t M1 = 0xCD9E8D57;
+    constexpr uint32_t W0 = 0x9E3779B9;
+    constexpr uint32_t W1 = 0xBB67AE85;
+
+    for (int round = 0; round < 10; ++round)
+    {
+        uint64_t p0 = M0 * counter[0];
+        uint64_t p1 = M1 * counter[2];
+        counter = {
+            static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ key[0],
+            static_cast<uint32_t>(p1),
+            static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ key[1],
+            static_cast<uint32_t>(p0)};
+        key[0] += W0;
+        key[1] += W1;
+    }
+    return counter;
+}
+
+double Philox::unit(uint32_t hi, uint32_t lo)
+{
+    return static_cast<double>(((static_cast<uint64_t>(hi) << 32) | lo) >> 11) * 0x1.0p-53;
+}
+
+namespace
+{
+    constexpr size_t min_chunk = 4096;
+    constexpr double pi = 3.14159265358979323846;
+
+    std::array<uint32_t, 4> draw(uint64_t seed, uint64_t stream, uint64_t index)
+    {
+        return Philox::generate(
+            {static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32),
+             static_cast<uint32_t>(stream), static_cast<uint32_t>(stream >> 32)},
+            {static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)});
+    }
+
+    double uniformAt(uint64_t seed, uint64_t stream, uint64_t index)
+    {
+        auto r = draw(seed, stream, index);
+        return Philox::unit(r[0], r[1]);
+    }
+
+    // Box-Muller, one normal per counter so each element stays independent of its neighbours
+    double normalAt(uint64_t seed, uint64_t stream, uint64_t index)
+    {
+        auto r = draw(seed, stream, index);
+        double u1 = 1.0 - Philox::unit(r[0], r[1]);
+        double u2 = Philox::unit(r[2], r[3]);
+        return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * pi * u2);
+    }
+
+    template <typename F>
+    void parallelFill(std::vector<std::shared_ptr<Value>> &params, unsigned num_threads, F value_at)
+    {
+        size_t n = params.size();
+        size_t threads = std::max<size_t>(1, std::min<size_t>(num_threads, (n + min_chunk - 1) / min_chunk));
+        auto fill = [&params, &value_at](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                params[i]->data = value_at(i);
+            }
+        };
+
+        if (threads == 1)
+        {
+            fill(0, n);
+            return;
+        }
+
+        size_t chunk = (n + threads - 1) / threads;
+        std::vector<std::thread> workers;
+        workers.reserve(threads - 1);
+        for (size_t t = 1; t < threads; ++t)
+        {
+            workers.emplace_back(fill, std::min(n, t * chunk), std::min(n, (t + 1) * chunk));
+        }
+        fill(0, std::min(n, chunk));
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    size_t fan(size_t fan_in, size_t fan_out, std::string_view mode)
+    {
+        if (mode == "fan_in")
+        {
+            return fan_in;
+        }
+        if (mode == "fan_out")
+        {
+            return fan_out;
+        }
+        throw std::invalid_argument("Initializer: mode must be fan_in or fan_out");
+    }
+}
+
+double calculate_gain(std::string_view nonlinearity, double param)
+{
+    if (nonlinearity == "linear" || nonlinearity == "identity" || nonlinearity == "sigmoid")
+    {
+        return 1.0;
+    }
+    if (nonlinearity == "tanh")
+    {
+        return 5.0 / 3.0;
+    }
+    if (nonlinearity == "relu")
+    {
+        return std::sqrt(2.0);
+    }
+    if (nonlinearity == "leaky_relu")
+    {
+        return std::sqrt(2.0 / (1.0 + param * param));
+    }
+    throw std::invalid_argument("Initializer: unsupported nonlinearity");
+}
+
+Initializer::Initializer(uint64_t seed, unsigned num_threads) : seed(seed), stream(0), num_threads(std::max(1u, num_threads)) {}
+
+void Initializer::weights(std::vector<std::shared_ptr<Value>> &params, size_t fan_in, size_t fan_out)
+{
+    // Kaiming Initialization
+    kaiming_uniform(params, fan_in, fan_out, 0.0, "fan_in", "relu");
+}
+
+void Initializer::uniform(std::vector<std::shared_ptr<Value>> &params, double a, double b)
+{
+    uint64_t seed = this->seed;
+    uint64_t stream = this->stream++;
+    parallelFill(params, num_threads, [=](size_t i)
+                 { return a + (b - a) * uniformAt(seed, stream, i); });
+}
+
+void Initializer::normal(std::vector<std::shared_ptr<Value>> &params, double mean, double std)
+{
+    uint64_t seed = this->seed;
+    uint64_t stream = this->stream++;
+    parallelFill(params, num_threads, [=](size_t i)
+                 { return mean + std * normalAt(seed, stream, i); });
+}
+
+void Initializer::constant(std::vector<std::shared_ptr<Value>> &params, double constant)
+{
+    parallelFill(params, num_threads, [constant](size_t)
+                 { return constant; });
+}
+
+void Initializer::xavier_uniform(std::vector<std::shared_ptr<Value>> &params, size_t fan_in, size_t fan_out, double gain)
+{
+    double bound = gain * std::sqrt(6.0 / static_cast<double>(fan_in + fan_out));
+    uniform(params, -bound, bound);
+}
+
+void Initializer::xavier_normal(std::vector<std::shared_ptr<Value>> &params, size_t fan_in, size_t fan_out, double gain)
+{
+    double stddev = gain * std::sqrt(2.0 / static_cast<double>(fan_in + fan_out));
+    normal(params, 0.0, stddev);
+}
+
+void Initializer::kaiming_uniform(std::vector<std::shared_ptr<Value>> &params, size_t fan_in, size_t fan_out, double a, std::string_view mode, std::string_view nonlinearity)
+{
+    double stddev = calculate_gain(nonlinearity, a) / std::sqrt(static_cast<double>(fan(fan_in, fan_out, mode)));
+    double bound = std::sqrt(3.0) * stddev;
+    uniform(params, -bound, bound);
+}
+
+void Initializer::kaiming_normal(std::vector<std::shared_ptr<Value>> &params, size_t fan_in, size_t fan_out, double a, std::string_view mode, std::string_view nonlinearity)
+{
+    double stddev = calculate_gain(nonlinearity, a) / std::sqrt(static_cast<double>(fan(fan_in, fan_out, mode)));
+    normal(params, 0.0, stddev);
+}
@@ -1,14 +1,41 @@
+#pragma once
 #include "value.h"
+#include <array>
+#include <cstdint>
 #include <string_view>
+#include <thread>
+
+// Counter-based Philox4x32-10, output depends only on (key, counter)
+struct Philox
+{
+    static std::array<uint32_t, 4> generate(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key);
+    // [0, 1) from two output words, 53 random bits
+    static double unit(uint32_t hi, uint32_t lo);
+};
+
+// Element i of every fill only depends on (seed, stream, i), so initialization
+// runs in parallel chunks and yields the same bits for any num_threads.
+// Every call consumes a new stream, so consecutive layers get distinct values.
 struct Initializer
 {
-    // Initializer(gernator)
+    uint64_t seed;
+    uint64_t stream;
+    unsigned num_threads;
+
+    Initializer(uint64_t seed = 42, unsigned num_threads = std::thread::hardware_concurrency());
+    virtual ~Initializer() = default;
+
+    // Used by Layer for its weights, override to plug in another scheme
+    virtual void weights(std::vector<std::shared_ptr<Value>> &params, size_t fan_in, size_t fan_out);
+
     void uniform(std::vector<std::shared_ptr<Value>> &params, double a = 0.0, double b = 1.0);
     void normal(std::vector<std::shared_ptr<Value>> &params, double mean = 0.0, double std = 1.0);
     void constant(std::vector<std::shared_ptr<Value>> &params, double constant);
 
-    void xavier_uniform(std::vector<std::shared_ptr<Value>> &params, double gain = 1.0);
-    void xavier_normal(std::vector<std::shared_ptr<Value>> &params, double gain = 1.0);
-    void kaiming_uniform(std::vector<std::shared_ptr<Value>> &params, double a = 0.0, std::string_view mode = "fan_in", std::string_view nonlinearity = "leaky_relu");
-    void kaiming_normal(std::vector<std::shared_ptr<Value>> &params, double a = 0.0, std::string_view mode = "fan_in", std::string_view nonlinearity = "leaky_relu");
-};
\ No newline at end of file
+    void xavier_uniform(std::vector<std::shared_ptr<Value>> &params, size_t fan_in, size_t fan_out, double gain = 1.0);
+    void xavier_normal(std::vector<std::shared_ptr<Value>> &params, size_t fan_in, size_t fan_out, double gain = 1.0);
+    void kaiming_uniform(std::vector<std::shared_ptr<Value>> &params, size_t fan_in, size_t fan_out, double a = 0.0, std::string_view mode = "fan_in", std::string_view nonlinearity = "leaky_relu");
+    void kaiming_normal(std::vector<std::shared_ptr<Value>> &params, size_t fan_in, size_t fan_out, double a = 0.0, std::string_view mode = "fan_in", std::string_view nonlinearity = "leaky_relu");
+};
+
+double calculate_gain(std::string_view nonlinearity, double param = 0.01);
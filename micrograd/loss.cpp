@@ -1,5 +1,6 @@
 #include "loss.h"
 #include "iostream"
+#include "expr.h"
 
 std::shared_ptr<Value> crossEntropyLoss(const std::vector<std::shared_ptr<Value>> &y_pred, const std::vector<std::shared_ptr<Value>> &y_truth)
 {
@@ -17,7 +18,7 @@ std::shared_ptr<Value> crossEntropyLoss(const std::vector<std::shared_ptr<Value>
 
     for (std::shared_ptr<Value> &v : probs)
     {
-        sum = sum + exp(v - logits_max);
+        sum = expr::lazy(sum) + exp(expr::lazy(v) - logits_max);
     }
 
     std::shared_ptr<Value> log_sum = log(sum);
@@ -26,7 +27,7 @@ std::shared_ptr<Value> crossEntropyLoss(const std::vector<std::shared_ptr<Value>
 
     for (size_t i = 0; i < y_pred.size(); ++i)
     {
-        if (y_truth.at(i))
+        if (y_truth.at(i)->data != 0.0)
         {
             truth = i;
             break;
@@ -35,7 +36,7 @@ std::shared_ptr<Value> crossEntropyLoss(const std::vector<std::shared_ptr<Value>
 
     std::shared_ptr<Value> pred = y_pred.at(truth);
 
-    return -pred + logits_max + log_sum;
+    return -expr::lazy(pred) + logits_max + log_sum;
 }
 
 std::shared_ptr<Value> svm(const std::vector<std::shared_ptr<Value>> &y_pred, const std::vector<std::shared_ptr<Value>> &y_truth, double margin)
@@ -45,7 +46,7 @@ std::shared_ptr<Value> svm(const std::vector<std::shared_ptr<Value>> &y_pred, co
 
     for (size_t i = 0; i < y_pred.size(); ++i)
     {
-        if (y_truth.at(i))
+        if (y_truth.at(i)->data != 0.0)
         {
             truth = i;
             break;
@@ -61,7 +62,7 @@ std::shared_ptr<Value> svm(const std::vector<std::shared_ptr<Value>> &y_pred, co
             continue;
         }
 
-        loss = loss + max(std::make_shared<Value>(0.0), (y_pred.at(i) - y_pred.at(truth)) + std::make_shared<Value>(margin));
+        loss = loss + max(std::make_shared<Value>(0.0), expr::lazy(y_pred.at(i)) - y_pred.at(truth) + margin);
     }
 
     return loss;
@@ -73,8 +74,33 @@ std::shared_ptr<Value> mse(const std::vector<std::shared_ptr<Value>> &y_pred, co
 
     for (size_t i = 0; i < y_pred.size(); ++i)
     {
-        loss = loss + (y_pred.at(i) - y_truth.at(i)) * (y_pred.at(i) - y_truth.at(i));
+        loss = expr::lazy(loss) + (expr::lazy(y_pred.at(i)) - y_truth.at(i)) * (expr::lazy(y_pred.at(i)) - y_truth.at(i));
     }
 
     return loss / std::make_shared<Value>(y_pred.size());
+}
+
+double crossEntropyLossGrad(const std::vector<double> &logits, size_t truth, std::vector<double> &grad)
+{
+    double logits_max = logits.at(0);
+    for (size_t i = 1; i < logits.size(); ++i)
+    {
+        logits_max = (logits[i] > logits_max) ? logits[i] : logits_max;
+    }
+
+    grad.resize(logits.size());
+    double sum = 0.0;
+    for (size_t i = 0; i < logits.size(); ++i)
+    {
+        grad[i] = std::exp(logits[i] - logits_max);
+        sum += grad[i];
+    }
+
+    for (size_t i = 0; i < logits.size(); ++i)
+    {
+        grad[i] /= sum;
+    }
+    grad.at(truth) -= 1.0;
+
+    return -logits.at(truth) + logits_max + std::log(sum);
 }
\ No newline at end of file
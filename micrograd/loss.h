@@ -1,4 +1,6 @@
+#pragma once
 #include <memory>
+#include <vector>
 #include "value.h"
 #include "ops.h"
 
@@ -8,3 +10,6 @@ std::shared_ptr<Value> crossEntropyLoss(const std::vector<std::shared_ptr<Value>
 std::shared_ptr<Value> mse(const std::vector<std::shared_ptr<Value>> &y_pred, const std::shared_ptr<Value> &y_truth);
 
 std::shared_ptr<Value> svm(const std::vector<std::shared_ptr<Value>> &y_pred, const std::shared_ptr<Value> &y_truth, double margin = 1.0);
+
+// Softmax cross entropy on plain logits, writes dL/dlogits into grad and returns the loss
+double crossEntropyLossGrad(const std::vector<double> &logits, size_t truth, std::vector<double> &grad);
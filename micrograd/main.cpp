@@ -12,10 +12,33 @@
 #include "optimizer.h"
 #include "loss.h"
 #include "helper.h"
+#include "quantize.h"
+#include "prefetch.h"
+#include "sweep.h"
+#include "accumulate.h"
+#include "ngram.h"
+#include "plan.h"
+#include "codegen.h"
+#include "static_nn.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
 
-int main()
+int main(int argc, char **argv)
 {
     std::string path = "names.txt";
+
+    if (argc > 1 && std::string(argv[1]) == "sweep")
+    {
+        Dataset dataset = Dataset(path, 2);
+        SweepSpace space = {{{}, {32}, {64}}, {"relu", "tanh", "leakyRelu", "sigmoid"}, {"SGD", "Adam"}, {0.01, 0.1}};
+        std::vector<SweepResult> results = runSweep(dataset, space.grid());
+        writeCsv(results, "sweep.csv");
+        writeJson(results, "sweep.json");
+        std::cout << "Best : " << results.at(0).config.optimizer << " " << results.at(0).config.activation << " lr " << results.at(0).config.learning_rate << " val loss " << results.at(0).val_loss << std::endl;
+        return 0;
+    }
     std::ifstream file(path);
 
     std::string n;
@@ -45,64 +68,273 @@ int main()
         ctoi[*it] = i;
     }
 
+    if (argc > 1 && std::string(argv[1]) == "ngram")
+    {
+        auto start = std::chrono::steady_clock::now();
+        NGram ngram = NGram(names, ctoi, 3, 1.0);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Trigram counts built in " << ms << " ms" << std::endl;
+        std::cout << "Avg nll : " << -ngram.logLikelihood(names) / ngram.tokens(names) << std::endl;
+        for (const auto &name : ngram.sample(10))
+        {
+            std::cout << name << std::endl;
+        }
+        return 0;
+    }
+
     std::unordered_map<int, char> itoc;
     for (const auto &pair : ctoi)
     {
         itoc[pair.second] = pair.first;
     }
 
-    std::vector<std::vector<std::shared_ptr<Value>>> x;
-    std::vector<std::vector<std::shared_ptr<Value>>> y;
-    x.reserve(names.size());
-    y.reserve(names.size());
-
     size_t total_chars = unique_chars.size() + 1;
 
-    for (const auto &name : names)
+    MLP mlp = MLP(total_chars + total_chars, {27}, {id});
+    Adam adam = Adam(mlp.parameters(), 0.01, 0.001, 0.9, 0.999, 1e-7);
+
+    std::function<std::shared_ptr<Value>(const std::vector<std::shared_ptr<Value>> &, const std::vector<std::shared_ptr<Value>> &)> loss_fn = [](const auto &y_pred, const auto &y_truth)
+    { return crossEntropyLoss(y_pred, y_truth); };
+
+    int iterations = 100;
+
+    if (argc > 1 && std::string(argv[1]) == "lazy")
     {
-        std::string n = "." + name + ".";
-        for (size_t i = 0; i < n.length() - 2; ++i)
+        // Each lazy optimizer trains a twin of a dense one on the same samples; one-hot inputs touch 2 of 54 rows
+        Dataset dataset = Dataset(path, 2, 0.0);
+        auto compare = [&](const std::string &name, auto make_lazy, auto make_dense)
         {
-            char char1 = n[i];
-            char char2 = n[i + 1];
-            char char3 = n[i + 2];
+            Initializer lazy_init(7);
+            Initializer dense_init(7);
+            MLP lazy_mlp = MLP(total_chars + total_chars, {27}, {id}, lazy_init);
+            MLP dense_mlp = MLP(total_chars + total_chars, {27}, {id}, dense_init);
+            auto lazy = make_lazy(lazy_mlp.parameters(), lazy_mlp.inputRows());
+            auto dense = make_dense(dense_mlp.parameters());
 
-            int index1 = ctoi[char1];
-            int index2 = ctoi[char2];
-            int index3 = ctoi[char3];
+            for (size_t step = 0; step < 20; ++step)
+            {
+                const int *example = dataset.train.data() + step * 7 * (dataset.context + 1);
+                std::vector<std::shared_ptr<Value>> x = dataset.input(example);
+                std::vector<std::shared_ptr<Value>> y = dataset.target(example);
 
-            std::vector<std::shared_ptr<Value>> first = one_hot(std::make_shared<Value>(index1), total_chars);
-            std::vector<std::shared_ptr<Value>> second = one_hot(std::make_shared<Value>(index2), total_chars);
-            std::vector<std::shared_ptr<Value>> third = one_hot(std::make_shared<Value>(index3), total_chars);
+                lazy.touch(x);
+                loss_fn(lazy_mlp.forward(x), y)->backward();
+                loss_fn(dense_mlp.forward(x), y)->backward();
+                lazy.verify();
+                lazy.step();
+                dense.step();
+                lazy_mlp.zero_grad();
+                dense_mlp.zero_grad();
+            }
+            lazy.flush();
 
-            x.emplace_back(concate(first, second));
-            y.emplace_back(third);
-        }
+            double max_diff = 0.0;
+            std::vector<std::shared_ptr<Value>> a = lazy_mlp.parameters();
+            std::vector<std::shared_ptr<Value>> b = dense_mlp.parameters();
+            for (size_t k = 0; k < a.size(); ++k)
+            {
+                max_diff = std::max(max_diff, std::abs(a.at(k)->data - b.at(k)->data));
+            }
+            std::cout << name << " max diff to dense : " << max_diff << std::endl;
+        };
+
+        compare("LazySGD", [](auto params, auto rows)
+                { return LazySGD(params, rows, 0.1, 0.01, 0.9); }, [](auto params)
+                { return SGD(params, 0.1, 0.01, 0.9); });
+        compare("LazyAdaGrad", [](auto params, auto rows)
+                { return LazyAdaGrad(params, rows, 0.1, 0.01); }, [](auto params)
+                { return AdaGrad(params, 0.1, 0.01); });
+        // LazyAdam drops the moment drift of skipped rows, so it only tracks Adam approximately
+        compare("LazyAdam", [](auto params, auto rows)
+                { return LazyAdam(params, rows, 0.01, 0.001); }, [](auto params)
+                { return Adam(params, 0.01, 0.001); });
+        return 0;
     }
 
-    MLP mlp = MLP(total_chars + total_chars, {27}, {id});
-    Adam adam = Adam(mlp.parameters(), 0.01, 0.001, 0.9, 0.999, 1e-7);
+    if (argc > 1 && std::string(argv[1]) == "plan")
+    {
+        Plan plan = Plan(Trace(mlp.parameters(), total_chars + total_chars, [&mlp](const std::vector<std::shared_ptr<Value>> &x)
+                               { return mlp.forward(x); }));
+        std::cout << "Planned bytes : " << plan.plannedBytes() << " naive bytes : " << plan.naiveBytes() << std::endl;
 
-    std::function<std::shared_ptr<Value>(const std::vector<std::shared_ptr<Value>> &, const std::vector<std::shared_ptr<Value>> &)> loss_fn = crossEntropyLoss;
+        // Index-encoded examples one-hot encoded into a reused buffer, so the loop doesn't allocate
+        Dataset dataset = Dataset(path, 2, 0.0);
+        std::vector<size_t> order(dataset.trainSize());
+        std::iota(order.begin(), order.end(), 0);
+        std::mt19937_64 generator(42);
+        std::shuffle(order.begin(), order.end(), generator);
+        size_t position = 0;
+        size_t batch_size = 1000;
 
-    int iterations = 100;
+        std::vector<double> input(total_chars + total_chars);
+        std::vector<double> grad;
+        for (int i = 0; i < iterations; ++i)
+        {
+            double loss = 0.0;
+            plan.zero_grad();
+            for (size_t j = 0; j < batch_size; ++j)
+            {
+                if (position == order.size())
+                {
+                    std::shuffle(order.begin(), order.end(), generator);
+                    position = 0;
+                }
+                const int *example = dataset.train.data() + order[position++] * (dataset.context + 1);
+                encodeInput(example, dataset.context, dataset.num_classes, input);
+
+                loss += crossEntropyLossGrad(plan.forward(input), example[dataset.context], grad);
+                for (double &g : grad)
+                {
+                    g /= batch_size;
+                }
+                plan.backward(grad);
+            }
+            adam.step();
+
+            std::cout << "Avg Loss : " << loss / batch_size << std::endl;
+        }
+        return 0;
+    }
+
+    Prefetcher prefetcher = Prefetcher(names, ctoi, 2, 1000);
 
     for (int i = 0; i < iterations; ++i)
     {
 
-        std::shared_ptr<Value> loss = std::make_shared<Value>(0.0);
-        for (int j = 0; j < 1000; ++j)
-        {
-            std::vector<std::shared_ptr<Value>> pred = mlp.forward(x.at(j));
-            std::vector<std::shared_ptr<Value>> truth = y.at(j);
+        const Batch &batch = prefetcher.next();
+
+        double loss = accumulateStep(mlp, adam, batch.x.size(), 100, [&](size_t j)
+                                     { return loss_fn(mlp.forward(batch.x.at(j)), batch.y.at(j)); });
 
-            loss = loss + loss_fn(pred, truth);
+        std::cout << "Avg Loss : " << loss << std::endl;
+    }
+
+    std::cout << "Data stall (s) : " << prefetcher.stallSeconds() << std::endl;
+
+    if (argc > 1 && std::string(argv[1]) == "codegen")
+    {
+        // Emitted after training, so the kernel embeds the trained parameters
+        std::string source = argc > 2 ? argv[2] : "generated/model_kernel.cpp";
+        Trace trace = Trace(mlp.parameters(), total_chars + total_chars, [&mlp](const std::vector<std::shared_ptr<Value>> &x)
+                            { return mlp.forward(x); });
+        writeSource(trace, source, {"model", true});
+        std::cout << "Wrote " << source << ", build and run with : " << compileCommand(source, "model_kernel") << " && ./model_kernel" << std::endl;
+
+        // Same synthetic workload as the generated main(), through the interpreted graph
+        size_t samples = 1000;
+        unsigned long long state = 42;
+        double loss = 0.0;
+        std::vector<std::shared_ptr<Value>> x(total_chars + total_chars);
+        std::vector<std::shared_ptr<Value>> y(total_chars);
+        auto start = std::chrono::steady_clock::now();
+        for (size_t s = 0; s < samples; ++s)
+        {
+            for (size_t i = 0; i < x.size(); ++i)
+            {
+                state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+                x[i] = std::make_shared<Value>(static_cast<double>(state >> 11) * 0x1.0p-53);
+            }
+            for (size_t i = 0; i < y.size(); ++i)
+            {
+                y[i] = std::make_shared<Value>(i == s % total_chars ? 1.0 : 0.0);
+            }
+            std::shared_ptr<Value> l = loss_fn(mlp.forward(x), y);
+            l->backward();
+            loss += l->data;
         }
-        loss = loss / std::make_shared<Value>(x.size());
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / samples;
+        std::cout << "Interpreted forward+backward : " << ns << " ns/sample, avg loss " << loss / samples << std::endl;
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "static")
+    {
+        // Fixed-shape copy of the trained model, load() throws if names.txt changes the widths
+        StaticMLP<54, Dense<27>> fixed = StaticMLP<54, Dense<27>>(mlp);
+        const Batch &batch = prefetcher.next();
+
         mlp.zero_grad();
-        loss->backward();
-        adam.step();
+        double graph_loss = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (size_t j = 0; j < batch.x.size(); ++j)
+        {
+            std::shared_ptr<Value> l = loss_fn(mlp.forward(batch.x.at(j)), batch.y.at(j));
+            l->backward();
+            graph_loss += l->data;
+        }
+        double graph_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / batch.x.size();
+
+        std::array<double, 54> x;
+        std::array<double, 27> grad;
+        double static_loss = 0.0;
+        start = std::chrono::steady_clock::now();
+        for (size_t j = 0; j < batch.x.size(); ++j)
+        {
+            size_t truth = 0;
+            for (size_t k = 0; k < x.size(); ++k)
+            {
+                x[k] = batch.x[j][k]->data;
+            }
+            while (batch.y[j][truth]->data == 0.0)
+            {
+                ++truth;
+            }
+            static_loss += crossEntropyLoss(fixed.forward(x), truth, grad);
+            fixed.backward(grad);
+        }
+        double static_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / batch.x.size();
 
-        std::cout << "Avg Loss : " << loss->data << std::endl;
+        // Largest gap between the two models' accumulated weight and bias gradients
+        const auto &layer = std::get<0>(fixed.layers);
+        double max_diff = std::abs(graph_loss - static_loss) / batch.x.size();
+        for (size_t o = 0; o < 27; ++o)
+        {
+            for (size_t k = 0; k < 54; ++k)
+            {
+                max_diff = std::max(max_diff, std::abs(layer.w_grad[o][k] - mlp.layers.at(0).neurons.at(o).w.at(k)->grad));
+            }
+            max_diff = std::max(max_diff, std::abs(layer.b_grad[o] - mlp.layers.at(0).neurons.at(o).b->grad));
+        }
+
+        std::cout << "Static max diff : " << max_diff << std::endl;
+        std::cout << "Graph forward+backward : " << graph_ns << " ns/sample, static : " << static_ns << " ns/sample" << std::endl;
+        return 0;
+    }
+
+    std::vector<std::vector<std::shared_ptr<Value>>> calibration = prefetcher.next().x;
+    std::vector<std::vector<std::shared_ptr<Value>>> evaluation = prefetcher.next().x;
+    QuantizedMLP quantized = QuantizedMLP(mlp, calibration, {[](double v)
+                                                             { return v; }});
+
+    std::cout << "Int8 top-1 agreement : " << top1Agreement(mlp, quantized, evaluation) << std::endl;
+
+    // Inference throughput over the evaluation batch, against the same model in fp64
+    std::vector<std::vector<double>> samples(evaluation.size(), std::vector<double>(total_chars + total_chars));
+    for (size_t j = 0; j < evaluation.size(); ++j)
+    {
+        for (size_t k = 0; k < samples[j].size(); ++k)
+        {
+            samples[j][k] = evaluation[j][k]->data;
+        }
+    }
+    StaticMLP<54, Dense<27>> fixed = StaticMLP<54, Dense<27>>(mlp);
+    std::array<double, 54> x;
+    size_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (const auto &sample : samples)
+    {
+        checksum += quantized.predict(sample);
+    }
+    double int8_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / samples.size();
+    start = std::chrono::steady_clock::now();
+    for (const auto &sample : samples)
+    {
+        std::copy(sample.begin(), sample.end(), x.begin());
+        const auto &y = fixed.forward(x);
+        checksum += std::max_element(y.begin(), y.end()) - y.begin();
     }
+    double fp64_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / samples.size();
+    std::cout << "Int8 kernel : " << dotInt8Kernel() << " int8 : " << int8_ns << " ns/sample fp64 : " << fp64_ns << " ns/sample (checksum " << checksum << ")" << std::endl;
+    std::cout << "Int8 bytes : " << quantized.memoryBytes() << " payload : " << quantized.payloadBytes() << " fp64 bytes : " << mlp.parameters().size() * sizeof(double) << std::endl;
 }
\ No newline at end of file
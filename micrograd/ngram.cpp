@@ -0,0 +1,260 @@
+#include "ngram.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include "init.h"
+
+namespace
+{
+    // Throws when base^exponent doesn't fit, keys would wrap and collide
+    uint64_t power(uint64_t base, size_t exponent)
+    {
+        uint64_t result = 1;
+        for (size_t i = 0; i < exponent; ++i)
+        {
+            if (base != 0 && result > std::numeric_limits<uint64_t>::max() / base)
+            {
+                throw std::invalid_argument("NGram: num_classes^order overflows the 64-bit key space");
+            }
+            result *= base;
+        }
+        return result;
+    }
+
+    // Runs fn(thread, begin, end) over contiguous chunks of [0, n)
+    void parallelFor(size_t n, unsigned num_threads, const std::function<void(size_t, size_t, size_t)> &fn)
+    {
+        size_t threads = std::max<size_t>(1, std::min<size_t>(num_threads, n));
+        size_t chunk = (n + threads - 1) / threads;
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < threads; ++t)
+        {
+            workers.emplace_back(fn, t, std::min(n, t * chunk), std::min(n, (t + 1) * chunk));
+        }
+        fn(0, 0, std::min(n, chunk));
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    // Calls fn(context, next) for every token of the padded name
+    template <typename F>
+    void forEachToken(const std::string &name, const std::unordered_map<char, int> &ctoi, size_t order, uint64_t num_contexts, F fn)
+    {
+        uint64_t context = 0;
+        uint64_t num_classes = ctoi.size();
+        std::string padded = std::string(order - 1, '.') + name + ".";
+        for (size_t i = 0; i < padded.length(); ++i)
+        {
+            int next = ctoi.at(padded[i]);
+            if (i + 1 >= order)
+            {
+                fn(context, next);
+            }
+            if (num_contexts > 1)
+            {
+                context = (context * num_classes + next) % num_contexts;
+            }
+        }
+    }
+}
+
+NGram::NGram(const std::vector<std::string> &names, const std::unordered_map<char, int> &ctoi, size_t order, double smoothing, unsigned num_threads)
+    : order(order), num_classes(ctoi.size()), smoothing(smoothing), ctoi(ctoi), itoc(ctoi.size())
+{
+    if (order == 0 || num_classes == 0)
+    {
+        throw std::invalid_argument("NGram: order and vocabulary must be non-empty");
+    }
+    for (const auto &pair : ctoi)
+    {
+        itoc.at(pair.second) = pair.first;
+    }
+
+    uint64_t num_keys = power(num_classes, order);
+    uint64_t num_contexts = num_keys / num_classes;
+    dense = num_keys <= max_dense;
+    num_threads = std::max(1u, num_threads);
+
+    if (dense)
+    {
+        // Every thread holds a full histogram, so large tables get fewer threads
+        num_threads = static_cast<unsigned>(std::clamp<uint64_t>(max_histogram_bytes / (num_keys * sizeof(uint32_t)), 1, num_threads));
+        std::vector<std::vector<uint32_t>> local(num_threads);
+        parallelFor(names.size(), num_threads, [&](size_t t, size_t begin, size_t end)
+                    {
+                        local.at(t).assign(num_keys, 0);
+                        for (size_t i = begin; i < end; ++i)
+                        {
+                            forEachToken(names[i], this->ctoi, order, num_contexts, [&](uint64_t context, int next)
+                                         { ++local[t][context * num_classes + next]; });
+                        } });
+
+        counts.assign(num_keys, 0);
+        for (const auto &histogram : local)
+        {
+            for (size_t k = 0; k < histogram.size(); ++k)
+            {
+                counts[k] += histogram[k];
+            }
+        }
+
+        context_counts.assign(num_contexts, 0);
+        for (uint64_t k = 0; k < num_keys; ++k)
+        {
+            context_counts[k / num_classes] += counts[k];
+        }
+        return;
+    }
+
+    std::vector<std::unordered_map<uint64_t, uint32_t>> local(num_threads);
+    parallelFor(names.size(), num_threads, [&](size_t t, size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        forEachToken(names[i], this->ctoi, order, num_contexts, [&](uint64_t context, int next)
+                                     { ++local[t][context * num_classes + next]; });
+                    } });
+
+    std::unordered_map<uint64_t, uint32_t> merged = std::move(local.at(0));
+    for (size_t t = 1; t < local.size(); ++t)
+    {
+        for (const auto &pair : local.at(t))
+        {
+            merged[pair.first] += pair.second;
+        }
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> sorted(merged.begin(), merged.end());
+    std::sort(sorted.begin(), sorted.end());
+    keys.reserve(sorted.size());
+    counts.reserve(sorted.size());
+    for (const auto &pair : sorted)
+    {
+        keys.emplace_back(pair.first);
+        counts.emplace_back(pair.second);
+
+        // Sorted by key, so every context is one contiguous run
+        uint64_t context = pair.first / num_classes;
+        if (context_keys.empty() || context_keys.back() != context)
+        {
+            context_keys.emplace_back(context);
+            context_counts.emplace_back(0);
+        }
+        context_counts.back() += pair.second;
+    }
+}
+
+uint32_t NGram::count(uint64_t key) const
+{
+    if (dense)
+    {
+        return counts[key];
+    }
+    auto it = std::lower_bound(keys.begin(), keys.end(), key);
+    return (it != keys.end() && *it == key) ? counts[it - keys.begin()] : 0;
+}
+
+uint32_t NGram::contextCount(uint64_t context) const
+{
+    if (dense)
+    {
+        return context_counts[context];
+    }
+    auto it = std::lower_bound(context_keys.begin(), context_keys.end(), context);
+    return (it != context_keys.end() && *it == context) ? context_counts[it - context_keys.begin()] : 0;
+}
+
+double NGram::probability(uint64_t context, int next) const
+{
+    double denominator = contextCount(context) + smoothing * num_classes;
+    if (denominator == 0.0)
+    {
+        return 0.0;
+    }
+    return (count(context * num_classes + next) + smoothing) / denominator;
+}
+
+double NGram::logLikelihood(const std::vector<std::string> &names, unsigned num_threads) const
+{
+    // Per name, summed in order afterwards so the result doesn't depend on num_threads
+    std::vector<double> per_name(names.size(), 0.0);
+    uint64_t num_contexts = power(num_classes, order - 1);
+    parallelFor(names.size(), std::max(1u, num_threads), [&](size_t, size_t begin, size_t end)
+                {
+                    for (size_t i = begin; i < end; ++i)
+                    {
+                        double sum = 0.0;
+                        forEachToken(names[i], ctoi, order, num_contexts, [&](uint64_t context, int next)
+                                     { sum += std::log(probability(context, next)); });
+                        per_name[i] = sum;
+                    } });
+
+    double total = 0.0;
+    for (double l : per_name)
+    {
+        total += l;
+    }
+    return total;
+}
+
+size_t NGram::tokens(const std::vector<std::string> &names) const
+{
+    size_t total = 0;
+    for (const auto &name : names)
+    {
+        total += name.length() + 1;
+    }
+    return total;
+}
+
+std::vector<std::string> NGram::sample(size_t count, uint64_t seed, size_t max_length, unsigned num_threads) const
+{
+    std::vector<std::string> out(count);
+    uint64_t num_contexts = power(num_classes, order - 1);
+    int end = ctoi.at('.');
+
+    parallelFor(count, std::max(1u, num_threads), [&](size_t, size_t begin, size_t stop)
+                {
+                    for (size_t i = begin; i < stop; ++i)
+                    {
+                        uint64_t context = 0;
+                        for (size_t k = 0; k + 1 < order; ++k)
+                        {
+                            context = (context * num_classes + end) % num_contexts;
+                        }
+
+                        for (size_t step = 0; step < max_length; ++step)
+                        {
+                            auto r = Philox::generate({static_cast<uint32_t>(i), static_cast<uint32_t>(i >> 32), static_cast<uint32_t>(step), 0},
+                                                      {static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)});
+                            double u = Philox::unit(r[0], r[1]);
+
+                            int next = static_cast<int>(num_classes) - 1;
+                            double cumulative = 0.0;
+                            for (size_t c = 0; c < num_classes; ++c)
+                            {
+                                cumulative += probability(context, static_cast<int>(c));
+                                if (u < cumulative)
+                                {
+                                    next = static_cast<int>(c);
+                                    break;
+                                }
+                            }
+
+                            if (next == end)
+                            {
+                                break;
+                            }
+                            out[i] += itoc[next];
+                            if (num_contexts > 1)
+                            {
+                                context = (context * num_classes + next) % num_contexts;
+                            }
+                        }
+                    } });
+    return out;
+}
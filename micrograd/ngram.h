@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Count-based character model as in makemore part 1, for any order. Names are padded with
+// order - 1 leading '.' and one trailing '.', probabilities use additive smoothing.
+// Counts are built from per-thread histograms merged at the end and kept dense when
+// num_classes^order is small, else as sorted sparse (key, count) arrays.
+struct NGram
+{
+    static constexpr size_t max_dense = size_t(1) << 24;
+    // Budget for the per-thread dense histograms together, caps the counting threads
+    static constexpr size_t max_histogram_bytes = size_t(1) << 28;
+
+    size_t order;
+    size_t num_classes;
+    double smoothing;
+    bool dense;
+    std::unordered_map<char, int> ctoi;
+    std::vector<char> itoc;
+
+    // Dense: indexed by key, sparse: sorted keys with matching counts
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> counts;
+    std::vector<uint64_t> context_keys;
+    std::vector<uint32_t> context_counts;
+
+    NGram(const std::vector<std::string> &names, const std::unordered_map<char, int> &ctoi, size_t order = 2, double smoothing = 1.0, unsigned num_threads = std::thread::hardware_concurrency());
+
+    double probability(uint64_t context, int next) const;
+    // Summed log-likelihood of the names, divide by tokens() for the average nll
+    double logLikelihood(const std::vector<std::string> &names, unsigned num_threads = std::thread::hardware_concurrency()) const;
+    size_t tokens(const std::vector<std::string> &names) const;
+    // Sample i only depends on (seed, i), so the output doesn't change with num_threads
+    std::vector<std::string> sample(size_t count, uint64_t seed = 42, size_t max_length = 64, unsigned num_threads = std::thread::hardware_concurrency()) const;
+
+private:
+    uint32_t count(uint64_t key) const;
+    uint32_t contextCount(uint64_t context) const;
+};
@@ -1,4 +1,22 @@
 #include "nn.h"
+#include <mutex>
+
+namespace
+{
+    std::mutex default_mutex;
+
+    Initializer &defaultInitializer()
+    {
+        static Initializer initializer;
+        return initializer;
+    }
+
+    // Leaves the weights at zero, for layers that fill all their neurons in one call
+    struct Deferred : Initializer
+    {
+        void weights(std::vector<std::shared_ptr<Value>> &, size_t, size_t) override {}
+    };
+}
 
 void Module::zero_grad()
 {
@@ -11,21 +29,21 @@ void Module::zero_grad()
 
 Neuron::Neuron(int dim_in, const std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)> activation)
 {
-    this->activation = activation;
-
-    static std::default_random_engine generator(42);
+    std::lock_guard<std::mutex> lock(default_mutex);
+    *this = Neuron(dim_in, activation, defaultInitializer());
+}
 
-    // Kaiming Initialization
+Neuron::Neuron(int dim_in, const std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)> activation, Initializer &initializer)
+{
+    this->activation = activation;
 
-    double bound = std::sqrt(6.0 / dim_in);
-    static std::uniform_real_distribution<double> distribution(-bound, bound);
     w.reserve(dim_in);
 
     for (int i = 0; i < dim_in; ++i)
     {
-        double number = distribution(generator);
-        w.emplace_back(std::make_shared<Value>(number));
+        w.emplace_back(std::make_shared<Value>(0.0));
     }
+    initializer.weights(w, dim_in, 1);
 
     this->b = std::make_shared<Value>(0.0);
 }
@@ -36,14 +54,33 @@ std::shared_ptr<Value> Neuron::forward(const std::vector<std::shared_ptr<Value>>
     {
         // std::cerr << "Error: Input size " << x.size() << " doesn't match weight size " << w.size() << std::endl;
     }
-    std::shared_ptr<Value> sum = std::make_shared<Value>(0.0);
-    for (size_t i = 0; i < w.size(); ++i)
+
+    // The activations from ops.h fuse into the same node, any other one is applied after it
+    using Function = std::shared_ptr<Value> (*)(const std::shared_ptr<Value> &);
+    const Function *f = activation.target<Function>();
+    if (!f)
+    {
+        auto inner = activation.target<std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)>>();
+        f = inner ? inner->target<Function>() : nullptr;
+    }
+
+    if (f && *f == static_cast<Function>(id))
+    {
+        return expr::dense<expr::op::Id>(x, w, b);
+    }
+    if (f && *f == static_cast<Function>(ops::tanh))
+    {
+        return expr::dense<expr::op::Tanh>(x, w, b);
+    }
+    if (f && *f == static_cast<Function>(relu))
+    {
+        return expr::dense<expr::op::Relu>(x, w, b);
+    }
+    if (f && *f == static_cast<Function>(sigmoid))
     {
-        auto mul = x.at(i) * w.at(i);
-        sum = sum + mul;
+        return expr::dense<expr::op::Sigmoid>(x, w, b);
     }
-    sum = sum + b;
-    return activation(sum);
+    return activation(expr::dense<expr::op::None>(x, w, b));
 }
 
 std::vector<std::shared_ptr<Value>> Neuron::parameters()
@@ -53,14 +90,39 @@ std::vector<std::shared_ptr<Value>> Neuron::parameters()
     return params;
 }
 
-Layer::Layer(int dim_in, int dim_out, std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)> activation)
+namespace
 {
-    for (int i = 0; i < dim_out; ++i)
+    void buildLayer(std::vector<Neuron> &neurons, int dim_in, int dim_out, const std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)> &activation, Initializer &initializer)
     {
-        neurons.emplace_back(dim_in, activation);
+        Deferred deferred;
+        neurons.reserve(dim_out);
+        for (int i = 0; i < dim_out; ++i)
+        {
+            neurons.emplace_back(dim_in, activation, deferred);
+        }
+
+        // One call for the whole layer, so large layers are filled in parallel chunks
+        std::vector<std::shared_ptr<Value>> weights;
+        weights.reserve(static_cast<size_t>(dim_in) * dim_out);
+        for (size_t i = 0; i < neurons.size(); ++i)
+        {
+            weights.insert(weights.end(), neurons.at(i).w.begin(), neurons.at(i).w.end());
+        }
+        initializer.weights(weights, dim_in, dim_out);
     }
 }
 
+Layer::Layer(int dim_in, int dim_out, std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)> activation)
+{
+    std::lock_guard<std::mutex> lock(default_mutex);
+    buildLayer(neurons, dim_in, dim_out, activation, defaultInitializer());
+}
+
+Layer::Layer(int dim_in, int dim_out, std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)> activation, Initializer &initializer)
+{
+    buildLayer(neurons, dim_in, dim_out, activation, initializer);
+}
+
 std::vector<std::shared_ptr<Value>> Layer::forward(const std::vector<std::shared_ptr<Value>> &x)
 {
     std::vector<std::shared_ptr<Value>> out;
@@ -90,20 +152,34 @@ std::vector<std::shared_ptr<Value>> Layer::parameters()
     return params;
 }
 
-MLP::MLP(const int &dim_in, const std::vector<int> &layers, const std::vector<std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)>> &activations)
+namespace
 {
-    std::vector<std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)>> act = activations;
-    if (act.empty())
+    void buildMLP(std::vector<Layer> &mlp_layers, const int &dim_in, const std::vector<int> &layers, const std::vector<std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)>> &activations, Initializer &initializer)
     {
-        act.resize(layers.size(), [](std::shared_ptr<Value> i)
-                   { return i; });
+        std::vector<std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)>> act = activations;
+        if (act.empty())
+        {
+            act.resize(layers.size(), [](std::shared_ptr<Value> i)
+                       { return i; });
+        }
+
+        mlp_layers.emplace_back(Layer(dim_in, layers.at(0), act.at(0), initializer));
+        for (size_t i = 0; i < layers.size() - 1; ++i)
+        {
+            mlp_layers.emplace_back(Layer(layers.at(i), layers.at(i + 1), act.at(i + 1), initializer));
+        }
     }
+}
 
-    this->layers.emplace_back(Layer(dim_in, layers.at(0), act.at(0)));
-    for (size_t i = 0; i < layers.size() - 1; ++i)
-    {
-        this->layers.emplace_back(Layer(layers.at(i), layers.at(i + 1), act.at(i + 1)));
-    }
+MLP::MLP(const int &dim_in, const std::vector<int> &layers, const std::vector<std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)>> &activations)
+{
+    std::lock_guard<std::mutex> lock(default_mutex);
+    buildMLP(this->layers, dim_in, layers, activations, defaultInitializer());
+}
+
+MLP::MLP(const int &dim_in, const std::vector<int> &layers, const std::vector<std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)>> &activations, Initializer &initializer)
+{
+    buildMLP(this->layers, dim_in, layers, activations, initializer);
 }
 
 std::vector<std::shared_ptr<Value>> MLP::forward(const std::vector<std::shared_ptr<Value>> &x)
@@ -135,4 +211,21 @@ std::vector<std::shared_ptr<Value>> MLP::parameters()
         params.insert(params.end(), layer_params.begin(), layer_params.end());
     }
     return params;
+}
+
+std::vector<std::vector<size_t>> MLP::inputRows()
+{
+    const std::vector<Neuron> &neurons = layers.at(0).neurons;
+    size_t dim_in = neurons.at(0).w.size();
+    std::vector<std::vector<size_t>> rows(dim_in);
+
+    for (size_t i = 0; i < dim_in; ++i)
+    {
+        rows.at(i).reserve(neurons.size());
+        for (size_t o = 0; o < neurons.size(); ++o)
+        {
+            rows.at(i).emplace_back(o * (dim_in + 1) + i);
+        }
+    }
+    return rows;
 }
\ No newline at end of file
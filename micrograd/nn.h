@@ -3,6 +3,8 @@
 #include <random>
 #include "value.h"
 #include "ops.h"
+#include "init.h"
+#include "expr.h"
 
 struct Module
 {
@@ -19,16 +21,20 @@ struct Neuron : public Module
 
     Neuron(int dim_in, const std::function<std::shared_ptr<Value>(const std::shared_ptr<Value>&)> activation = [](std::shared_ptr<Value> i)
                        { return i; });
+    Neuron(int dim_in, const std::function<std::shared_ptr<Value>(const std::shared_ptr<Value>&)> activation, Initializer &initializer);
     std::shared_ptr<Value> forward(const std::vector<std::shared_ptr<Value>>& x);
     std::vector<std::shared_ptr<Value>> parameters() override;
 };
 
+// Constructors without an Initializer draw from one process-wide Initializer (seed 42), so
+// every default-built module gets its own weights while a run stays reproducible.
 struct Layer : public Module
 {
     std::vector<Neuron> neurons;
 
     Layer(int dim_in, int dim_out, const std::function<std::shared_ptr<Value>(const std::shared_ptr<Value>&)> activation = [](std::shared_ptr<Value> i)
                                    { return i; });
+    Layer(int dim_in, int dim_out, const std::function<std::shared_ptr<Value>(const std::shared_ptr<Value>&)> activation, Initializer &initializer);
 
     std::vector<std::shared_ptr<Value>> forward(const std::vector<std::shared_ptr<Value>> &x);
     std::vector<std::shared_ptr<Value>> parameters() override;
@@ -38,6 +44,9 @@ struct MLP : public Module
 {
     std::vector<Layer> layers;
     MLP(const int &dim_in, const std::vector<int> &layers, const std::vector<std::function<std::shared_ptr<Value>(const std::shared_ptr<Value>&)>> &activations = {});
+    MLP(const int &dim_in, const std::vector<int> &layers, const std::vector<std::function<std::shared_ptr<Value>(const std::shared_ptr<Value>&)>> &activations, Initializer &initializer);
     std::vector<std::shared_ptr<Value>> forward(const std::vector<std::shared_ptr<Value>> &x);
     std::vector<std::shared_ptr<Value>> parameters() override;
+    // Indices into parameters() of the first layer weights reading input i, one row per input
+    std::vector<std::vector<size_t>> inputRows();
 };
\ No newline at end of file
@@ -5,8 +5,9 @@ std::shared_ptr<Value> operator+(const std::shared_ptr<Value> &a, const std::sha
 {
     auto res = std::make_shared<Value>(a->data + b->data);
     res->children = {a, b};
+    res->op = Op::Add;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         const auto &b = res->children.second;
@@ -21,8 +22,9 @@ std::shared_ptr<Value> operator*(const std::shared_ptr<Value> &a, const std::sha
 {
     auto res = std::make_shared<Value>(a->data * b->data);
     res->children = {a, b};
+    res->op = Op::Mul;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         const auto &b = res->children.second;
@@ -41,8 +43,9 @@ std::shared_ptr<Value> pow(const std::shared_ptr<Value> &a, const std::shared_pt
 {
     auto res = std::make_shared<Value>(std::pow(a->data, b->data));
     res->children = {a, b};
+    res->op = Op::Pow;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         const auto &b = res->children.second;
@@ -58,8 +61,9 @@ std::shared_ptr<Value> operator/(const std::shared_ptr<Value> &a, const std::sha
 {
     auto res = std::make_shared<Value>(a->data / b->data);
     res->children = {a, b};
+    res->op = Op::Div;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         const auto &b = res->children.second;
@@ -74,8 +78,9 @@ std::shared_ptr<Value> operator-(const std::shared_ptr<Value> &a, const std::sha
 {
     auto res = std::make_shared<Value>(a->data - b->data);
     res->children = {a, b};
+    res->op = Op::Sub;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         const auto &b = res->children.second;
@@ -101,8 +106,9 @@ bool operator==(const std::shared_ptr<Value> &a, const std::shared_ptr<Value> &b
 std::shared_ptr<Value> max(const std::shared_ptr<Value> &a, const std::shared_ptr<Value> &b){
     auto res = std::make_shared<Value>(a->data > b->data ? a->data : b->data);
     res->children = {a, b};
+    res->op = Op::Max;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         const auto &b = res->children.second;
@@ -122,8 +128,9 @@ std::shared_ptr<Value> max(const std::shared_ptr<Value> &a, const std::shared_pt
 std::shared_ptr<Value> min(const std::shared_ptr<Value> &a, const std::shared_ptr<Value> &b){
     auto res = std::make_shared<Value>(a->data > b->data ? b->data: a->data);
     res->children = {a, b};
+    res->op = Op::Min;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         const auto &b = res->children.second;
@@ -143,8 +150,9 @@ std::shared_ptr<Value> min(const std::shared_ptr<Value> &a, const std::shared_pt
 std::shared_ptr<Value> operator+(const std::shared_ptr<Value>&value){
     auto res = std::make_shared<Value>(value->data);
     res->children = {value, nullptr};
+    res->op = Op::Pos;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         a->grad += res->grad;
@@ -156,8 +164,9 @@ std::shared_ptr<Value> operator+(const std::shared_ptr<Value>&value){
 std::shared_ptr<Value> operator-(const std::shared_ptr<Value>&value){
     auto res = std::make_shared<Value>(-value->data);
     res->children = {value, nullptr};
+    res->op = Op::Neg;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         a->grad -= res->grad;
@@ -169,8 +178,9 @@ std::shared_ptr<Value> operator-(const std::shared_ptr<Value>&value){
 std::shared_ptr<Value> sqrt(const std::shared_ptr<Value> &value){
     auto res = std::make_shared<Value>(std::sqrt(value->data));
     res->children = {value, nullptr};
+    res->op = Op::Sqrt;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         a->grad += res->grad /(2*res->data);
@@ -182,8 +192,9 @@ std::shared_ptr<Value> sqrt(const std::shared_ptr<Value> &value){
 std::shared_ptr<Value> exp(const std::shared_ptr<Value> &value){
     auto res = std::make_shared<Value>(std::exp(value->data));
     res->children = {value, nullptr};
+    res->op = Op::Exp;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         a->grad += res->grad * res->data;
@@ -196,8 +207,9 @@ std::shared_ptr<Value> exp(const std::shared_ptr<Value> &value){
 std::shared_ptr<Value> log(const std::shared_ptr<Value> &value){
     auto res = std::make_shared<Value>(std::log(value->data));
     res->children = {value, nullptr};
+    res->op = Op::Log;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         a->grad += res->grad / a->data;
@@ -209,8 +221,9 @@ std::shared_ptr<Value> log(const std::shared_ptr<Value> &value){
 std::shared_ptr<Value> id(const std::shared_ptr<Value> &value){
     auto res = std::make_shared<Value>(value->data);
     res->children = {value, nullptr};
+    res->op = Op::Id;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         a->grad += res->grad;
@@ -222,8 +235,9 @@ std::shared_ptr<Value> id(const std::shared_ptr<Value> &value){
 std::shared_ptr<Value> sigmoid(const std::shared_ptr<Value> &value){
     auto res = std::make_shared<Value>(1.0 / (1.0 + std::exp(-value->data)));
     res->children = {value, nullptr};
+    res->op = Op::Sigmoid;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         a->grad += res->grad * res->data * (1 - res->data);
@@ -235,8 +249,9 @@ std::shared_ptr<Value> sigmoid(const std::shared_ptr<Value> &value){
 std::shared_ptr<Value> ops::tanh(const std::shared_ptr<Value> &value){
     auto res = std::make_shared<Value>(std::tanh(value->data));
     res->children = {value, nullptr};
+    res->op = Op::Tanh;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         a->grad += res->grad * (1 - res->data * res->data);
@@ -248,8 +263,9 @@ std::shared_ptr<Value> ops::tanh(const std::shared_ptr<Value> &value){
 std::shared_ptr<Value> relu(const std::shared_ptr<Value> &value){
     std::shared_ptr<Value> res = std::make_shared<Value>((value->data < 0.0) ? 0.0 : value->data);
     res->children = {value, nullptr};
+    res->op = Op::Relu;
 
-    res->_backward = [res]()
+    res->_backward = [res = res.get()]()
     {
         const auto &a = res->children.first;
         a->grad += res->grad * ((a->data < 0) ? 0.0 : 1.0);
@@ -260,8 +276,10 @@ std::shared_ptr<Value> relu(const std::shared_ptr<Value> &value){
 std::shared_ptr<Value> leakyRelu(const std::shared_ptr<Value> &value, const double &alpha){
     std::shared_ptr<Value> res = std::make_shared<Value>((value->data < 0.0) ? alpha * value->data : value->data);
     res->children = {value, nullptr};
+    res->op = Op::LeakyRelu;
+    res->param = alpha;
 
-    res->_backward = [res, alpha]()
+    res->_backward = [res = res.get(), alpha]()
     {
         const auto &a = res->children.first;
         a->grad += res->grad * ((a->data < 0.0) ? alpha : 1.0);
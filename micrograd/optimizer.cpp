@@ -1,5 +1,7 @@
 #include "optimizer.h"
 #include <iostream>
+#include <cmath>
+#include <stdexcept>
 Optimizer::Optimizer(std::vector<std::shared_ptr<Value>> parameters, double learning_rate, double weight_decay) : parameters(parameters), learning_rate(learning_rate), weight_decay(weight_decay){}
 
 SGD::SGD(std::vector<std::shared_ptr<Value>> parameters, double learning_rate, double weight_decay, double rho) : Optimizer(parameters, learning_rate, weight_decay), rho(rho), velocities(parameters.size(), 0.0){}
@@ -52,7 +54,7 @@ void RMSProp::step()
 Adam::Adam(std::vector<std::shared_ptr<Value>> parameters, double learning_rate, double weight_decay, double beta1, double beta2, double epsilon) : Optimizer(parameters, learning_rate, weight_decay), epsilon(epsilon), beta1(beta1), beta2(beta2),moment1(parameters.size(), 0.0), moment2(parameters.size(), 0.0), t(1){}
 void Adam::step()
 {
-    for (size_t i = 0; i < parameters.size(); ++t, ++i)
+    for (size_t i = 0; i < parameters.size(); ++i)
     {
         moment1.at(i) = beta1 * moment1.at(i) + (1.0 - beta1) * parameters.at(i)->grad;
         moment2.at(i) = beta2 * moment2.at(i) + (1.0 - beta2) * parameters.at(i)->grad * parameters.at(i)->grad;
@@ -60,4 +62,161 @@ void Adam::step()
         double moment_unbias2 = moment2.at(i) / (1.0 - std::pow(beta2, t));
         parameters.at(i)->data -= learning_rate * (moment_unbias1 / (std::sqrt(moment_unbias2) + epsilon) + weight_decay * parameters.at(i)->data);
     }
-}
\ No newline at end of file
+    ++t;
+}
+
+LazyOptimizer::LazyOptimizer(std::vector<std::shared_ptr<Value>> parameters, std::vector<std::vector<size_t>> rows, double learning_rate, double weight_decay) : Optimizer(parameters, learning_rate, weight_decay), rows(rows), is_active(rows.size(), 0), last_step(rows.size(), 0), steps(0)
+{
+    std::vector<char> in_row(parameters.size(), 0);
+    for (const auto &row : this->rows)
+    {
+        for (size_t i : row)
+        {
+            in_row.at(i) = 1;
+        }
+    }
+    for (size_t i = 0; i < parameters.size(); ++i)
+    {
+        if (!in_row.at(i))
+        {
+            dense.emplace_back(i);
+        }
+    }
+}
+
+void LazyOptimizer::touch(size_t row)
+{
+    if (!is_active.at(row))
+    {
+        long skipped = steps - last_step.at(row);
+        if (skipped > 0)
+        {
+            for (size_t i : rows.at(row))
+            {
+                catchUp(i, skipped);
+            }
+        }
+        is_active.at(row) = 1;
+        active.emplace_back(row);
+    }
+}
+
+void LazyOptimizer::touch(const std::vector<std::shared_ptr<Value>> &x)
+{
+    for (size_t i = 0; i < x.size() && i < rows.size(); ++i)
+    {
+        if (x.at(i)->data != 0.0)
+        {
+            touch(i);
+        }
+    }
+}
+
+void LazyOptimizer::step()
+{
+    ++steps;
+    for (size_t i : dense)
+    {
+        apply(i);
+    }
+    for (size_t row : active)
+    {
+        for (size_t i : rows.at(row))
+        {
+            apply(i);
+        }
+        last_step.at(row) = steps;
+        is_active.at(row) = 0;
+    }
+    active.clear();
+}
+
+void LazyOptimizer::verify() const
+{
+    // Such a gradient would be dropped and the row's forward pass used stale weights
+    for (size_t row = 0; row < rows.size(); ++row)
+    {
+        if (is_active.at(row))
+        {
+            continue;
+        }
+        for (size_t i : rows.at(row))
+        {
+            if (parameters.at(i)->grad != 0.0)
+            {
+                throw std::logic_error("LazyOptimizer: row " + std::to_string(row) + " has a gradient but wasn't touched");
+            }
+        }
+    }
+}
+
+void LazyOptimizer::flush()
+{
+    for (size_t row = 0; row < rows.size(); ++row)
+    {
+        if (is_active.at(row))
+        {
+            continue;
+        }
+        long skipped = steps - last_step.at(row);
+        if (skipped > 0)
+        {
+            for (size_t i : rows.at(row))
+            {
+                catchUp(i, skipped);
+            }
+        }
+        last_step.at(row) = steps;
+    }
+}
+
+LazySGD::LazySGD(std::vector<std::shared_ptr<Value>> parameters, std::vector<std::vector<size_t>> rows, double learning_rate, double weight_decay, double rho) : LazyOptimizer(parameters, rows, learning_rate, weight_decay), rho(rho), velocities(parameters.size(), 0.0) {}
+
+void LazySGD::catchUp(size_t i, long skipped)
+{
+    // v_k = rho^k v, p_k = a^k p - lr * v * sum_{j=1..k} a^(k-j) rho^j with a = 1 - lr * wd
+    double a = 1.0 - learning_rate * weight_decay;
+    double a_k = std::pow(a, skipped);
+    double rho_k = std::pow(rho, skipped);
+    double drift = (std::abs(a - rho) < 1e-12) ? skipped * a_k : rho * (a_k - rho_k) / (a - rho);
+
+    parameters.at(i)->data = a_k * parameters.at(i)->data - learning_rate * velocities.at(i) * drift;
+    velocities.at(i) *= rho_k;
+}
+
+void LazySGD::apply(size_t i)
+{
+    velocities.at(i) = rho * velocities.at(i) + parameters.at(i)->grad;
+    parameters.at(i)->data -= learning_rate * (velocities.at(i) + weight_decay * parameters.at(i)->data);
+}
+
+LazyAdaGrad::LazyAdaGrad(std::vector<std::shared_ptr<Value>> parameters, std::vector<std::vector<size_t>> rows, double learning_rate, double weight_decay, double epsilon) : LazyOptimizer(parameters, rows, learning_rate, weight_decay), epsilon(epsilon), grad_squared(parameters.size(), 0.0) {}
+
+void LazyAdaGrad::catchUp(size_t i, long skipped)
+{
+    parameters.at(i)->data *= std::pow(1.0 - learning_rate * weight_decay, skipped);
+}
+
+void LazyAdaGrad::apply(size_t i)
+{
+    grad_squared.at(i) += parameters.at(i)->grad * parameters.at(i)->grad;
+    parameters.at(i)->data -= learning_rate * (parameters.at(i)->grad / (std::sqrt(grad_squared.at(i)) + epsilon) + weight_decay * parameters.at(i)->data);
+}
+
+LazyAdam::LazyAdam(std::vector<std::shared_ptr<Value>> parameters, std::vector<std::vector<size_t>> rows, double learning_rate, double weight_decay, double beta1, double beta2, double epsilon) : LazyOptimizer(parameters, rows, learning_rate, weight_decay), beta1(beta1), beta2(beta2), epsilon(epsilon), moment1(parameters.size(), 0.0), moment2(parameters.size(), 0.0) {}
+
+void LazyAdam::catchUp(size_t i, long skipped)
+{
+    moment1.at(i) *= std::pow(beta1, skipped);
+    moment2.at(i) *= std::pow(beta2, skipped);
+    parameters.at(i)->data *= std::pow(1.0 - learning_rate * weight_decay, skipped);
+}
+
+void LazyAdam::apply(size_t i)
+{
+    moment1.at(i) = beta1 * moment1.at(i) + (1.0 - beta1) * parameters.at(i)->grad;
+    moment2.at(i) = beta2 * moment2.at(i) + (1.0 - beta2) * parameters.at(i)->grad * parameters.at(i)->grad;
+    double moment_unbias1 = moment1.at(i) / (1.0 - std::pow(beta1, steps));
+    double moment_unbias2 = moment2.at(i) / (1.0 - std::pow(beta2, steps));
+    parameters.at(i)->data -= learning_rate * (moment_unbias1 / (std::sqrt(moment_unbias2) + epsilon) + weight_decay * parameters.at(i)->data);
+}
@@ -1,3 +1,4 @@
+#pragma once
 #include "value.h"
 struct Optimizer
 {
@@ -48,4 +49,71 @@ struct Adam : public Optimizer{
     std::vector<double> moment2;
     Adam(std::vector<std::shared_ptr<Value>> parameters, double learning_rate = 0.01, double weight_decay = 0.0, double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-7);
     void step() override;
-};
\ No newline at end of file
+};
+
+// Updates only parameters of rows touched since the last step, plus the parameters outside
+// every row. A row that was skipped for k steps had zero gradient during them, so its
+// missed decay/moment updates are applied in closed form when it's touched again.
+// Touch the rows of a sample before its forward pass so it sees caught-up weights.
+struct LazyOptimizer : public Optimizer
+{
+    std::vector<std::vector<size_t>> rows;
+    std::vector<size_t> dense;
+    std::vector<size_t> active;
+    std::vector<char> is_active;
+    std::vector<long> last_step;
+    long steps;
+
+    LazyOptimizer(std::vector<std::shared_ptr<Value>> parameters, std::vector<std::vector<size_t>> rows, double learning_rate = 0.01, double weight_decay = 0.0);
+    void touch(size_t row);
+    // Touches row i for every nonzero x[i], rows from MLP::inputRows()
+    void touch(const std::vector<std::shared_ptr<Value>> &x);
+    void step() override;
+    // Throws std::logic_error if an untouched row has a gradient, step() would drop it.
+    // Scans every parameter, so it's meant for debugging and checks, not every step.
+    void verify() const;
+    // Catches every row up to the current step, call before reading the parameters
+    void flush();
+
+protected:
+    virtual void catchUp(size_t i, long skipped) = 0;
+    virtual void apply(size_t i) = 0;
+};
+
+struct LazySGD : public LazyOptimizer
+{
+    double rho;
+    std::vector<double> velocities;
+    LazySGD(std::vector<std::shared_ptr<Value>> parameters, std::vector<std::vector<size_t>> rows, double learning_rate = 0.01, double weight_decay = 0.0, double rho = 0.0);
+
+protected:
+    void catchUp(size_t i, long skipped) override;
+    void apply(size_t i) override;
+};
+
+struct LazyAdaGrad : public LazyOptimizer
+{
+    double epsilon;
+    std::vector<double> grad_squared;
+    LazyAdaGrad(std::vector<std::shared_ptr<Value>> parameters, std::vector<std::vector<size_t>> rows, double learning_rate = 0.01, double weight_decay = 0.0, double epsilon = 1e-7);
+
+protected:
+    void catchUp(size_t i, long skipped) override;
+    void apply(size_t i) override;
+};
+
+// Moments and weight decay are caught up exactly, the parameter drift from the decaying
+// moments during skipped steps is dropped (as in LazyAdam)
+struct LazyAdam : public LazyOptimizer
+{
+    double beta1;
+    double beta2;
+    double epsilon;
+    std::vector<double> moment1;
+    std::vector<double> moment2;
+    LazyAdam(std::vector<std::shared_ptr<Value>> parameters, std::vector<std::vector<size_t>> rows, double learning_rate = 0.01, double weight_decay = 0.0, double beta1 = 0.9, double beta2 = 0.999, double epsilon = 1e-7);
+
+protected:
+    void catchUp(size_t i, long skipped) override;
+    void apply(size_t i) override;
+};
@@ -0,0 +1,415 @@
+#include "plan.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+namespace
+{
+    struct Interval
+    {
+        size_t start;
+        size_t end;
+        size_t id; // 2 * node for its value, 2 * node + 1 for its gradient
+    };
+
+    // Greedy coloring of an interval graph, optimal when visited by start time
+    size_t colorIntervals(std::vector<Interval> &intervals, std::vector<size_t> &slot_of)
+    {
+        std::sort(intervals.begin(), intervals.end(), [](const Interval &x, const Interval &y)
+                  { return x.start < y.start; });
+
+        using Active = std::pair<size_t, size_t>; // end, slot
+        std::priority_queue<Active, std::vector<Active>, std::greater<Active>> active;
+        std::vector<size_t> free;
+        size_t num_slots = 0;
+
+        for (const Interval &interval : intervals)
+        {
+            while (!active.empty() && active.top().first < interval.start)
+            {
+                free.emplace_back(active.top().second);
+                active.pop();
+            }
+
+            size_t slot;
+            if (free.empty())
+            {
+                slot = num_slots++;
+            }
+            else
+            {
+                slot = free.back();
+                free.pop_back();
+            }
+            slot_of.at(interval.id) = slot;
+            active.push({interval.end, slot});
+        }
+        return num_slots;
+    }
+}
+
+Plan::Plan(const Trace &trace) : parameters(trace.parameters), num_inputs(trace.num_inputs)
+{
+    const std::vector<Trace::Node> &nodes = trace.nodes;
+
+    // Primitive ops get consecutive times, forward at t and backward at 2N - 1 - t
+    std::vector<int> time(nodes.size(), -1);
+    size_t n = 0;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (nodes.at(i).op != Op::Leaf)
+        {
+            time.at(i) = static_cast<int>(n++);
+        }
+    }
+    num_nodes = n;
+    size_t backward_start = n;
+    size_t end_of_run = 2 * n;
+    auto backwardTime = [n](size_t t)
+    { return 2 * n - 1 - t; };
+
+    std::vector<size_t> value_end(nodes.size(), 0);
+    std::vector<size_t> last_consumer(nodes.size(), 0);
+    std::vector<char> consumed(nodes.size(), 0);
+    std::vector<char> is_output(nodes.size(), 0);
+    for (int out : trace.outputs)
+    {
+        is_output.at(out) = 1;
+    }
+
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        const Trace::Node &node = nodes.at(i);
+        if (node.op == Op::Leaf)
+        {
+            continue;
+        }
+        size_t t = time.at(i);
+        value_end.at(i) = std::max(value_end.at(i), t);
+        if (needsOutput(node.op))
+        {
+            value_end.at(i) = std::max(value_end.at(i), backwardTime(t));
+        }
+        for (int operand : {node.a, node.b})
+        {
+            if (operand < 0)
+            {
+                continue;
+            }
+            value_end.at(operand) = std::max(value_end.at(operand), needsOperands(node.op) ? backwardTime(t) : t);
+            last_consumer.at(operand) = std::max(last_consumer.at(operand), t);
+            consumed.at(operand) = 1;
+        }
+    }
+
+    std::vector<Interval> intervals;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        if (nodes.at(i).op == Op::Leaf)
+        {
+            continue;
+        }
+        size_t t = time.at(i);
+        size_t end = is_output.at(i) ? end_of_run : value_end.at(i);
+        intervals.push_back({t, end, 2 * i});
+
+        size_t grad_start = is_output.at(i) ? backward_start : backwardTime(last_consumer.at(i));
+        if (!is_output.at(i) && !consumed.at(i))
+        {
+            throw std::logic_error("Plan: node doesn't reach an output");
+        }
+        intervals.push_back({grad_start, backwardTime(t), 2 * i + 1});
+    }
+
+    std::vector<size_t> slot_of(2 * nodes.size(), 0);
+    num_slots = colorIntervals(intervals, slot_of);
+
+    // Memory: parameters, inputs, constants, slots, parameter grads, one sink for other leaf grads
+    size_t num_parameters = parameters.size();
+    input_offset = num_parameters;
+    size_t constant_offset = input_offset + trace.num_inputs;
+    size_t slot_offset = constant_offset + trace.constants.size();
+    param_grad_offset = slot_offset + num_slots;
+    size_t sink = param_grad_offset + num_parameters;
+    memory.assign(sink + 1, 0.0);
+    std::copy(trace.constants.begin(), trace.constants.end(), memory.begin() + constant_offset);
+
+    auto valueAt = [&](int i) -> size_t
+    {
+        const Trace::Node &node = nodes.at(i);
+        switch (node.leaf)
+        {
+        case Trace::Leaf::Parameter:
+            return node.index;
+        case Trace::Leaf::Input:
+            return input_offset + node.index;
+        case Trace::Leaf::Constant:
+            return constant_offset + node.index;
+        default:
+            return slot_offset + slot_of.at(2 * i);
+        }
+    };
+    auto gradAt = [&](int i) -> size_t
+    {
+        const Trace::Node &node = nodes.at(i);
+        if (node.leaf == Trace::Leaf::Parameter)
+        {
+            return param_grad_offset + node.index;
+        }
+        return node.leaf == Trace::Leaf::None ? slot_offset + slot_of.at(2 * i + 1) : sink;
+    };
+
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        const Trace::Node &node = nodes.at(i);
+        if (node.op == Op::Leaf)
+        {
+            continue;
+        }
+        int b = node.b < 0 ? node.a : node.b;
+        instructions.push_back({node.op, node.param, valueAt(i), valueAt(node.a), valueAt(b), gradAt(i), gradAt(node.a), gradAt(b), false, false});
+    }
+
+    // The first gradient write into a slot assigns instead of accumulating, outputs are seeded
+    std::vector<char> written(nodes.size(), 0);
+    for (int out : trace.outputs)
+    {
+        written.at(out) = 1;
+    }
+    size_t k = instructions.size();
+    for (size_t i = nodes.size(); i-- > 0;)
+    {
+        const Trace::Node &node = nodes.at(i);
+        if (node.op == Op::Leaf)
+        {
+            continue;
+        }
+        Instr &instr = instructions.at(--k);
+        if (nodes.at(node.a).leaf == Trace::Leaf::None)
+        {
+            instr.assign_a = !written.at(node.a);
+            written.at(node.a) = 1;
+        }
+        if (node.b >= 0 && nodes.at(node.b).leaf == Trace::Leaf::None)
+        {
+            instr.assign_b = !written.at(node.b);
+            written.at(node.b) = 1;
+        }
+    }
+
+    for (int out : trace.outputs)
+    {
+        outputs.emplace_back(valueAt(out));
+        output_grads.emplace_back(gradAt(out));
+    }
+    result.resize(outputs.size());
+}
+
+const std::vector<double> &Plan::forward(const std::vector<double> &x)
+{
+    if (x.size() != num_inputs)
+    {
+        throw std::invalid_argument("Plan: input size doesn't match the trace");
+    }
+    for (size_t p = 0; p < parameters.size(); ++p)
+    {
+        memory[p] = parameters[p]->data;
+    }
+    std::copy(x.begin(), x.end(), memory.begin() + input_offset);
+
+    double *m = memory.data();
+    for (const Instr &in : instructions)
+    {
+        double a = m[in.a];
+        double b = m[in.b];
+        double y;
+        switch (in.op)
+        {
+        case Op::Add:
+            y = a + b;
+            break;
+        case Op::Sub:
+            y = a - b;
+            break;
+        case Op::Mul:
+            y = a * b;
+            break;
+        case Op::Div:
+            y = a / b;
+            break;
+        case Op::Pow:
+            y = std::pow(a, b);
+            break;
+        case Op::Max:
+            y = a > b ? a : b;
+            break;
+        case Op::Min:
+            y = a > b ? b : a;
+            break;
+        case Op::Neg:
+            y = -a;
+            break;
+        case Op::Exp:
+            y = std::exp(a);
+            break;
+        case Op::Sqrt:
+            y = std::sqrt(a);
+            break;
+        case Op::Log:
+            y = std::log(a);
+            break;
+        case Op::Tanh:
+            y = std::tanh(a);
+            break;
+        case Op::Relu:
+            y = (a < 0.0) ? 0.0 : a;
+            break;
+        case Op::Sigmoid:
+            y = 1.0 / (1.0 + std::exp(-a));
+            break;
+        case Op::LeakyRelu:
+            y = (a < 0.0) ? in.param * a : a;
+            break;
+        default: // Pos, Id
+            y = a;
+            break;
+        }
+        m[in.out] = y;
+    }
+
+    for (size_t i = 0; i < outputs.size(); ++i)
+    {
+        result[i] = m[outputs[i]];
+    }
+    return result;
+}
+
+void Plan::backward(const std::vector<double> &grad)
+{
+    if (grad.size() != output_grads.size())
+    {
+        throw std::invalid_argument("Plan: one gradient per output is required");
+    }
+
+    double *m = memory.data();
+    std::fill(memory.begin() + param_grad_offset, memory.end(), 0.0);
+    for (size_t i = 0; i < output_grads.size(); ++i)
+    {
+        m[output_grads[i]] = 0.0;
+    }
+    for (size_t i = 0; i < output_grads.size(); ++i)
+    {
+        m[output_grads[i]] += grad[i];
+    }
+
+    for (size_t k = instructions.size(); k-- > 0;)
+    {
+        const Instr &in = instructions[k];
+        double g = m[in.gout];
+        double a = m[in.a];
+        double b = m[in.b];
+        double da = 0.0;
+        double db = 0.0;
+        bool binary = true;
+        switch (in.op)
+        {
+        case Op::Add:
+            da = g;
+            db = g;
+            break;
+        case Op::Sub:
+            da = g;
+            db = -g;
+            break;
+        case Op::Mul:
+            da = g * b;
+            db = g * a;
+            break;
+        case Op::Div:
+            da = g / b;
+            db = -g * a / (b * b);
+            break;
+        case Op::Pow:
+            da = g * b * std::pow(a, b - 1.0);
+            db = g * m[in.out] * std::log(a);
+            break;
+        case Op::Max:
+            da = a > b ? g : 0.0;
+            db = a > b ? 0.0 : g;
+            break;
+        case Op::Min:
+            da = a > b ? 0.0 : g;
+            db = a > b ? g : 0.0;
+            break;
+        default:
+            binary = false;
+            break;
+        }
+
+        if (!binary)
+        {
+            double y = m[in.out];
+            switch (in.op)
+            {
+            case Op::Neg:
+                da = -g;
+                break;
+            case Op::Exp:
+                da = g * y;
+                break;
+            case Op::Sqrt:
+                da = g / (2 * y);
+                break;
+            case Op::Log:
+                da = g / a;
+                break;
+            case Op::Tanh:
+                da = g * (1 - y * y);
+                break;
+            case Op::Relu:
+                da = g * ((a < 0) ? 0.0 : 1.0);
+                break;
+            case Op::Sigmoid:
+                da = g * y * (1 - y);
+                break;
+            case Op::LeakyRelu:
+                da = g * ((a < 0.0) ? in.param : 1.0);
+                break;
+            default: // Pos, Id
+                da = g;
+                break;
+            }
+        }
+
+        m[in.ga] = in.assign_a ? da : m[in.ga] + da;
+        if (binary)
+        {
+            m[in.gb] = in.assign_b ? db : m[in.gb] + db;
+        }
+    }
+
+    for (size_t p = 0; p < parameters.size(); ++p)
+    {
+        parameters[p]->grad += m[param_grad_offset + p];
+    }
+}
+
+void Plan::zero_grad()
+{
+    for (const auto &parameter : parameters)
+    {
+        parameter->grad = 0.0;
+    }
+}
+
+size_t Plan::plannedBytes() const
+{
+    return memory.size() * sizeof(double);
+}
+
+size_t Plan::naiveBytes() const
+{
+    return (memory.size() - num_slots + 2 * num_nodes) * sizeof(double);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include "trace.h"
+
+// Runs a traced graph forward and backward inside one preplanned arena. Value and gradient
+// lifetimes over a forward + backward pass are computed once and packed into reusable slots
+// by greedy interval coloring, so repeated runs allocate nothing. Parameter grads are
+// accumulated into the parameters' Value::grad, so the usual optimizers keep working.
+struct Plan
+{
+    struct Instr
+    {
+        Op op;
+        double param;
+        size_t out, a, b;    // value locations
+        size_t gout, ga, gb; // gradient locations
+        bool assign_a, assign_b; // first gradient write into a reused slot
+    };
+
+    std::vector<std::shared_ptr<Value>> parameters;
+    size_t num_inputs;
+    std::vector<Instr> instructions;
+    std::vector<size_t> outputs;      // value locations
+    std::vector<size_t> output_grads; // gradient locations
+    std::vector<double> memory;
+    size_t input_offset;
+    size_t param_grad_offset;
+    size_t num_slots;
+    size_t num_nodes;
+
+    explicit Plan(const Trace &trace);
+
+    const std::vector<double> &forward(const std::vector<double> &x);
+    // Backpropagates dL/doutputs through the last forward and adds into the parameter grads
+    void backward(const std::vector<double> &grad);
+    // Zeroes the parameters' grads without rebuilding a parameter list, unlike Module::zero_grad
+    void zero_grad();
+
+    size_t plannedBytes() const;
+    // Same leaves, one value and one gradient per node without reuse
+    size_t naiveBytes() const;
+
+private:
+    std::vector<double> result;
+};
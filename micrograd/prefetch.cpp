@@ -0,0 +1,136 @@
+#include "prefetch.h"
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include "helper.h"
+
+Prefetcher::Prefetcher(const std::vector<std::string> &names, const std::unordered_map<char, int> &ctoi, size_t context, size_t batch_size, size_t num_buffers, uint64_t seed)
+    : ctoi(ctoi), context(context), batch_size(batch_size), num_classes(ctoi.size()), seed(seed),
+      buffers(num_buffers), current(0), has_current(false), stop(false), stall_seconds(0.0), idle_seconds(0.0), consumed(0)
+{
+    if (num_buffers < 2 || num_buffers > max_buffers)
+    {
+        throw std::invalid_argument("Prefetcher: num_buffers must be between 2 and 4");
+    }
+
+    for (const auto &name : names)
+    {
+        encodeName(name, ctoi, context, examples);
+    }
+    if (examples.empty())
+    {
+        // The producer would never publish a batch and next() would wait forever
+        throw std::invalid_argument("Prefetcher: names yield no examples for this context");
+    }
+
+    for (size_t i = 0; i < num_buffers; ++i)
+    {
+        buffers.at(i).x.reserve(batch_size);
+        buffers.at(i).y.reserve(batch_size);
+        free.push(i);
+    }
+
+    producer = std::thread(&Prefetcher::produce, this);
+}
+
+Prefetcher::~Prefetcher()
+{
+    stop.store(true, std::memory_order_release);
+    wakeProducer();
+    producer.join();
+}
+
+void Prefetcher::wakeProducer()
+{
+    // Taking the lock orders the push / stop before the producer's check, so no wakeup is lost
+    {
+        std::lock_guard<std::mutex> lock(free_mutex);
+    }
+    free_returned.notify_one();
+}
+
+const Batch &Prefetcher::next()
+{
+    if (has_current)
+    {
+        free.push(current);
+        wakeProducer();
+    }
+
+    if (!ready.pop(current))
+    {
+        auto start = std::chrono::steady_clock::now();
+        while (!ready.pop(current))
+        {
+            std::this_thread::yield();
+        }
+        stall_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    has_current = true;
+    ++consumed;
+    return buffers.at(current);
+}
+
+double Prefetcher::stallSeconds() const
+{
+    return stall_seconds;
+}
+
+double Prefetcher::idleSeconds() const
+{
+    return idle_seconds.load(std::memory_order_relaxed);
+}
+
+size_t Prefetcher::batches() const
+{
+    return consumed;
+}
+
+void Prefetcher::produce()
+{
+    size_t count = examples.size() / (context + 1);
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::mt19937_64 generator(seed);
+    std::shuffle(order.begin(), order.end(), generator);
+    size_t position = 0;
+
+    while (!stop.load(std::memory_order_acquire))
+    {
+        size_t slot;
+        if (!free.pop(slot))
+        {
+            auto start = std::chrono::steady_clock::now();
+            // Every buffer is full, sleep until next() hands one back
+            std::unique_lock<std::mutex> lock(free_mutex);
+            free_returned.wait(lock, [this, &slot]()
+                               { return stop.load(std::memory_order_acquire) || free.pop(slot); });
+            if (stop.load(std::memory_order_acquire))
+            {
+                return;
+            }
+            idle_seconds.store(idle_seconds.load(std::memory_order_relaxed) + std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+        }
+
+        Batch &batch = buffers.at(slot);
+        batch.x.clear();
+        batch.y.clear();
+        for (size_t b = 0; b < batch_size; ++b)
+        {
+            if (position == count)
+            {
+                std::shuffle(order.begin(), order.end(), generator);
+                position = 0;
+            }
+
+            const int *example = examples.data() + order.at(position++) * (context + 1);
+            batch.x.emplace_back(encodeInput(example, context, num_classes));
+            batch.y.emplace_back(one_hot(std::make_shared<Value>(example[context]), num_classes));
+        }
+
+        ready.push(slot);
+    }
+}
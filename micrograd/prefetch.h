@@ -0,0 +1,99 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "value.h"
+
+// Bounded lock-free single-producer single-consumer ring
+template <typename T, size_t Capacity>
+struct SpscQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+    std::array<T, Capacity> slots;
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+
+    bool push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        slots[t & (Capacity - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        item = slots[h & (Capacity - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+struct Batch
+{
+    std::vector<std::vector<std::shared_ptr<Value>>> x;
+    std::vector<std::vector<std::shared_ptr<Value>>> y;
+};
+
+// Encodes names through ctoi, shuffles every epoch and builds one-hot minibatches
+// on a producer thread, handing them to the training thread through a ring of
+// num_buffers (2 = double, 3 = triple buffering) preallocated batches.
+struct Prefetcher
+{
+    static constexpr size_t max_buffers = 4;
+
+    Prefetcher(const std::vector<std::string> &names, const std::unordered_map<char, int> &ctoi, size_t context, size_t batch_size, size_t num_buffers = 3, uint64_t seed = 42);
+    ~Prefetcher();
+    Prefetcher(const Prefetcher &) = delete;
+    Prefetcher &operator=(const Prefetcher &) = delete;
+
+    // Valid until the next call, the previous batch's buffer goes back to the producer
+    const Batch &next();
+
+    // Time the training thread spent waiting for data
+    double stallSeconds() const;
+    // Time the producer spent parked waiting for a free buffer
+    double idleSeconds() const;
+    size_t batches() const;
+
+private:
+    std::unordered_map<char, int> ctoi;
+    size_t context;
+    size_t batch_size;
+    size_t num_classes;
+    uint64_t seed;
+    std::vector<int> examples; // per example: context indices, then the target
+
+    std::vector<Batch> buffers;
+    SpscQueue<size_t, max_buffers> free;
+    SpscQueue<size_t, max_buffers> ready;
+    // The producer parks here while every buffer is full, the consumer only spins on a real stall
+    std::mutex free_mutex;
+    std::condition_variable free_returned;
+    size_t current;
+    bool has_current;
+
+    std::atomic<bool> stop;
+    double stall_seconds;
+    std::atomic<double> idle_seconds;
+    size_t consumed;
+    std::thread producer;
+
+    void produce();
+    void wakeProducer();
+};
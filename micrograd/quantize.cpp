@@ -0,0 +1,266 @@
+#include "quantize.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+    constexpr size_t kernel_width = 32;
+    // Largest quantized bias, with headroom for the rounding
+    constexpr double max_bias = 1073741824.0;
+
+    int8_t quantize(double x, double inv_scale)
+    {
+        double q = std::round(x * inv_scale);
+        return static_cast<int8_t>(std::clamp(q, -127.0, 127.0));
+    }
+
+    double maxAbs(const std::vector<std::shared_ptr<Value>> &values)
+    {
+        double m = 0.0;
+        for (const auto &v : values)
+        {
+            m = std::max(m, std::abs(v->data));
+        }
+        return m;
+    }
+
+    size_t argmax(const std::vector<double> &x)
+    {
+        return std::max_element(x.begin(), x.end()) - x.begin();
+    }
+}
+
+int32_t dotInt8Scalar(const int8_t *a, const int8_t *b, size_t n)
+{
+    int32_t sum = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        sum += static_cast<int32_t>(a[i]) * static_cast<int32_t>(b[i]);
+    }
+    return sum;
+}
+
+const char *dotInt8Kernel()
+{
+#if defined(__AVX2__) && defined(__AVX512VNNI__) && defined(__AVX512VL__)
+    return "avx512vnni";
+#elif defined(__AVX2__) && defined(__AVXVNNI__)
+    return "avxvnni";
+#elif defined(__AVX2__)
+    return "avx2";
+#elif defined(__ARM_NEON) && defined(__ARM_FEATURE_DOTPROD)
+    return "neon dotprod";
+#elif defined(__ARM_NEON)
+    return "neon";
+#else
+    return "scalar";
+#endif
+}
+
+int32_t dotInt8(const int8_t *a, const int8_t *b, size_t n)
+{
+    size_t i = 0;
+    int32_t sum = 0;
+
+#if defined(__AVX2__)
+    // u8 x s8 instructions: move the sign of a onto b, inputs are clamped to [-127, 127] so pairs can't saturate
+    __m256i acc = _mm256_setzero_si256();
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+        __m256i ua = _mm256_sign_epi8(va, va);
+        __m256i sb = _mm256_sign_epi8(vb, va);
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+        acc = _mm256_dpbusd_epi32(acc, ua, sb);
+#elif defined(__AVXVNNI__)
+        acc = _mm256_dpbusd_avx_epi32(acc, ua, sb);
+#else
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(ua, sb), _mm256_set1_epi16(1)));
+#endif
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    sum = _mm_cvtsi128_si32(s);
+#elif defined(__ARM_NEON)
+    int32x4_t acc = vdupq_n_s32(0);
+    for (; i + 16 <= n; i += 16)
+    {
+        int8x16_t va = vld1q_s8(a + i);
+        int8x16_t vb = vld1q_s8(b + i);
+#if defined(__ARM_FEATURE_DOTPROD)
+        acc = vdotq_s32(acc, va, vb);
+#else
+        int16x8_t lo = vmull_s8(vget_low_s8(va), vget_low_s8(vb));
+        int16x8_t hi = vmull_s8(vget_high_s8(va), vget_high_s8(vb));
+        acc = vpadalq_s16(acc, lo);
+        acc = vpadalq_s16(acc, hi);
+#endif
+    }
+    sum = vaddvq_s32(acc);
+#endif
+
+    return sum + dotInt8Scalar(a + i, b + i, n - i);
+}
+
+QuantizedMLP::QuantizedMLP(MLP &mlp, const std::vector<std::vector<std::shared_ptr<Value>>> &calibration, const std::vector<std::function<double(double)>> &activations)
+{
+    if (!activations.empty() && activations.size() != mlp.layers.size())
+    {
+        throw std::invalid_argument("QuantizedMLP: one activation per layer is required");
+    }
+    if (calibration.empty())
+    {
+        throw std::invalid_argument("QuantizedMLP: calibration set is empty");
+    }
+
+    // Calibrate the input range of every layer with the fp64 model
+    std::vector<double> x_max(mlp.layers.size(), 0.0);
+    for (const auto &sample : calibration)
+    {
+        std::vector<std::shared_ptr<Value>> out = sample;
+        for (size_t l = 0; l < mlp.layers.size(); ++l)
+        {
+            x_max.at(l) = std::max(x_max.at(l), maxAbs(out));
+            out = mlp.layers.at(l).forward(out);
+        }
+    }
+
+    // Parameters come in MLP::parameters() order: per layer, per neuron w..., b
+    std::vector<std::shared_ptr<Value>> params = mlp.parameters();
+    size_t p = 0;
+
+    layers.reserve(mlp.layers.size());
+    for (size_t l = 0; l < mlp.layers.size(); ++l)
+    {
+        Layer &source = mlp.layers.at(l);
+        QuantizedLayer layer;
+        layer.dim_out = source.neurons.size();
+        layer.dim_in = source.neurons.at(0).w.size();
+        layer.stride = (layer.dim_in + kernel_width - 1) / kernel_width * kernel_width;
+        layer.w.assign(layer.dim_out * layer.stride, 0);
+        layer.w_scale.resize(layer.dim_out);
+        layer.b.resize(layer.dim_out);
+        layer.x_scale = static_cast<float>((x_max.at(l) > 0.0 ? x_max.at(l) : 1.0) / 127.0);
+
+        for (size_t o = 0; o < layer.dim_out; ++o)
+        {
+            double w_max = 0.0;
+            for (size_t i = 0; i < layer.dim_in; ++i)
+            {
+                w_max = std::max(w_max, std::abs(params.at(p + i)->data));
+            }
+            double scale = (w_max > 0.0 ? w_max : 1.0) / 127.0;
+            // A channel with tiny weights and a larger bias gets a coarser scale, so its bias still fits in int32
+            double bias = params.at(p + layer.dim_in)->data;
+            scale = std::max(scale, std::abs(bias) / (static_cast<double>(layer.x_scale) * max_bias));
+            layer.w_scale.at(o) = static_cast<float>(scale);
+            for (size_t i = 0; i < layer.dim_in; ++i)
+            {
+                layer.w.at(o * layer.stride + i) = quantize(params.at(p + i)->data, 1.0 / scale);
+            }
+            layer.b.at(o) = static_cast<int32_t>(std::lround(bias / (static_cast<double>(layer.x_scale) * layer.w_scale.at(o))));
+            p += layer.dim_in + 1;
+        }
+
+        if (!activations.empty())
+        {
+            layer.activation = activations.at(l);
+        }
+        else
+        {
+            auto activation = source.neurons.at(0).activation;
+            layer.activation = [activation](double x)
+            { return activation(std::make_shared<Value>(x))->data; };
+        }
+        layers.emplace_back(std::move(layer));
+    }
+}
+
+std::vector<double> QuantizedMLP::forward(const std::vector<double> &x) const
+{
+    std::vector<double> out = x;
+    std::vector<int8_t> xq;
+
+    for (const QuantizedLayer &layer : layers)
+    {
+        xq.assign(layer.stride, 0);
+        double inv_scale = 1.0 / layer.x_scale;
+        for (size_t i = 0; i < layer.dim_in; ++i)
+        {
+            xq[i] = quantize(out.at(i), inv_scale);
+        }
+
+        out.resize(layer.dim_out);
+        for (size_t o = 0; o < layer.dim_out; ++o)
+        {
+            int32_t acc = dotInt8(layer.w.data() + o * layer.stride, xq.data(), layer.stride);
+            double z = static_cast<double>(static_cast<int64_t>(acc) + layer.b[o]) * layer.x_scale * layer.w_scale[o];
+            out[o] = layer.activation(z);
+        }
+    }
+    return out;
+}
+
+size_t QuantizedMLP::predict(const std::vector<double> &x) const
+{
+    return argmax(forward(x));
+}
+
+size_t QuantizedMLP::memoryBytes() const
+{
+    size_t bytes = 0;
+    for (const QuantizedLayer &layer : layers)
+    {
+        bytes += layer.w.size() * sizeof(int8_t) + layer.w_scale.size() * sizeof(float) + layer.b.size() * sizeof(int32_t) + sizeof(float);
+    }
+    return bytes;
+}
+
+size_t QuantizedMLP::payloadBytes() const
+{
+    size_t bytes = 0;
+    for (const QuantizedLayer &layer : layers)
+    {
+        bytes += layer.dim_in * layer.dim_out * sizeof(int8_t) + layer.w_scale.size() * sizeof(float) + layer.b.size() * sizeof(int32_t) + sizeof(float);
+    }
+    return bytes;
+}
+
+double top1Agreement(MLP &mlp, const QuantizedMLP &quantized, const std::vector<std::vector<std::shared_ptr<Value>>> &samples)
+{
+    if (samples.empty())
+    {
+        return 1.0;
+    }
+
+    size_t agree = 0;
+    std::vector<double> x;
+    std::vector<double> y;
+    for (const auto &sample : samples)
+    {
+        x.resize(sample.size());
+        for (size_t i = 0; i < sample.size(); ++i)
+        {
+            x[i] = sample[i]->data;
+        }
+
+        std::vector<std::shared_ptr<Value>> pred = mlp.forward(sample);
+        y.resize(pred.size());
+        for (size_t i = 0; i < pred.size(); ++i)
+        {
+            y[i] = pred[i]->data;
+        }
+
+        agree += (argmax(y) == quantized.predict(x));
+    }
+    return static_cast<double>(agree) / samples.size();
+}
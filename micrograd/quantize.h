@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "nn.h"
+
+// int8 x int8 -> int32, picks VNNI / AVX2 / NEON dotprod at compile time, scalar otherwise.
+// The x86 kernels need -mavx2 (or -march=native), without it the scalar loop runs.
+int32_t dotInt8(const int8_t *a, const int8_t *b, size_t n);
+int32_t dotInt8Scalar(const int8_t *a, const int8_t *b, size_t n);
+// Name of the kernel dotInt8 was compiled to
+const char *dotInt8Kernel();
+
+struct QuantizedLayer
+{
+    size_t dim_in;
+    size_t dim_out;
+    size_t stride; // dim_in padded to the kernel width
+    std::vector<int8_t> w;
+    std::vector<float> w_scale; // per output channel
+    std::vector<int32_t> b; // at scale x_scale * w_scale, added to the int32 accumulator
+    float x_scale; // per tensor, from calibration
+    std::function<double(double)> activation;
+};
+
+// Inference-only post-training quantization of a trained MLP: symmetric int8
+// weights per output channel, symmetric int8 inputs per layer calibrated on a
+// sample, int32 accumulation and bias, fp64 activation.
+struct QuantizedMLP
+{
+    std::vector<QuantizedLayer> layers;
+
+    // activations default to evaluating the MLP's own Value activations, pass
+    // plain double functions (e.g. [](double x){ return std::tanh(x); }) to skip the graph
+    QuantizedMLP(MLP &mlp, const std::vector<std::vector<std::shared_ptr<Value>>> &calibration, const std::vector<std::function<double(double)>> &activations = {});
+
+    std::vector<double> forward(const std::vector<double> &x) const;
+    size_t predict(const std::vector<double> &x) const;
+    // Resident bytes, rows included with their padding to the kernel width
+    size_t memoryBytes() const;
+    // Bytes of the model itself: unpadded int8 weights, scales and int32 biases
+    size_t payloadBytes() const;
+};
+
+// Fraction of samples where the int8 model and the fp64 MLP agree on the argmax
+double top1Agreement(MLP &mlp, const QuantizedMLP &quantized, const std::vector<std::vector<std::shared_ptr<Value>>> &samples);
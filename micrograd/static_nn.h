@@ -0,0 +1,304 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include "nn.h"
+
+// Activation policies, counterparts of id, ops::tanh, relu, sigmoid and leakyRelu
+namespace act
+{
+    struct Identity
+    {
+        static double forward(double x) { return x; }
+        static double derivative(double, double) { return 1.0; }
+    };
+
+    struct Tanh
+    {
+        static double forward(double x) { return std::tanh(x); }
+        static double derivative(double, double y) { return 1.0 - y * y; }
+    };
+
+    struct Relu
+    {
+        static double forward(double x) { return (x < 0.0) ? 0.0 : x; }
+        static double derivative(double x, double) { return (x < 0.0) ? 0.0 : 1.0; }
+    };
+
+    struct Sigmoid
+    {
+        static double forward(double x) { return 1.0 / (1.0 + std::exp(-x)); }
+        static double derivative(double, double y) { return y * (1.0 - y); }
+    };
+
+    struct LeakyRelu
+    {
+        static constexpr double alpha = 0.1;
+        static double forward(double x) { return (x < 0.0) ? alpha * x : x; }
+        static double derivative(double x, double) { return (x < 0.0) ? alpha : 1.0; }
+    };
+}
+
+// Layer spec for StaticMLP, e.g. StaticMLP<54, Dense<27, act::Identity>>
+template <size_t Out, typename Activation = act::Identity>
+struct Dense
+{
+    static constexpr size_t dim_out = Out;
+    using activation = Activation;
+};
+
+template <size_t In, size_t Out, typename Activation>
+struct StaticLayer
+{
+    std::array<std::array<double, In>, Out> w{};
+    std::array<double, Out> b{};
+    std::array<std::array<double, In>, Out> w_grad{};
+    std::array<double, Out> b_grad{};
+
+    // Cached by forward for backward
+    std::array<double, In> x{};
+    std::array<double, Out> z{};
+    std::array<double, Out> y{};
+    std::array<double, In> x_grad{};
+
+    const std::array<double, Out> &forward(const std::array<double, In> &input)
+    {
+        x = input;
+        for (size_t o = 0; o < Out; ++o)
+        {
+            double sum = b[o];
+            for (size_t i = 0; i < In; ++i)
+            {
+                sum += w[o][i] * x[i];
+            }
+            z[o] = sum;
+            y[o] = Activation::forward(sum);
+        }
+        return y;
+    }
+
+    template <bool PropagateInput = true>
+    const std::array<double, In> &backward(const std::array<double, Out> &y_grad)
+    {
+        if constexpr (PropagateInput)
+        {
+            x_grad.fill(0.0);
+        }
+        for (size_t o = 0; o < Out; ++o)
+        {
+            double dz = y_grad[o] * Activation::derivative(z[o], y[o]);
+            b_grad[o] += dz;
+            for (size_t i = 0; i < In; ++i)
+            {
+                w_grad[o][i] += dz * x[i];
+                if constexpr (PropagateInput)
+                {
+                    x_grad[i] += dz * w[o][i];
+                }
+            }
+        }
+        return x_grad;
+    }
+
+    void zero_grad()
+    {
+        for (auto &row : w_grad)
+        {
+            row.fill(0.0);
+        }
+        b_grad.fill(0.0);
+    }
+
+    void step(double learning_rate)
+    {
+        for (size_t o = 0; o < Out; ++o)
+        {
+            for (size_t i = 0; i < In; ++i)
+            {
+                w[o][i] -= learning_rate * w_grad[o][i];
+            }
+            b[o] -= learning_rate * b_grad[o];
+        }
+    }
+
+    void load(const Layer &layer)
+    {
+        if (layer.neurons.size() != Out || (Out > 0 && layer.neurons.at(0).w.size() != In))
+        {
+            throw std::invalid_argument("StaticLayer: shape doesn't match dynamic Layer");
+        }
+        for (size_t o = 0; o < Out; ++o)
+        {
+            for (size_t i = 0; i < In; ++i)
+            {
+                w[o][i] = layer.neurons.at(o).w.at(i)->data;
+            }
+            b[o] = layer.neurons.at(o).b->data;
+        }
+    }
+
+    void store(Layer &layer) const
+    {
+        if (layer.neurons.size() != Out || (Out > 0 && layer.neurons.at(0).w.size() != In))
+        {
+            throw std::invalid_argument("StaticLayer: shape doesn't match dynamic Layer");
+        }
+        for (size_t o = 0; o < Out; ++o)
+        {
+            for (size_t i = 0; i < In; ++i)
+            {
+                layer.neurons.at(o).w.at(i)->data = w[o][i];
+            }
+            layer.neurons.at(o).b->data = b[o];
+        }
+    }
+};
+
+namespace detail
+{
+    template <size_t In, typename... Specs>
+    struct LayerChain
+    {
+        using type = std::tuple<>;
+        static constexpr size_t dim_out = In;
+    };
+
+    template <size_t In, typename Spec, typename... Rest>
+    struct LayerChain<In, Spec, Rest...>
+    {
+        using next = LayerChain<Spec::dim_out, Rest...>;
+        using type = decltype(std::tuple_cat(
+            std::declval<std::tuple<StaticLayer<In, Spec::dim_out, typename Spec::activation>>>(),
+            std::declval<typename next::type>()));
+        static constexpr size_t dim_out = next::dim_out;
+    };
+}
+
+// Fixed-shape MLP: every width and activation is a template argument, so the
+// layer chain is expanded at compile time and the inner loops have constant
+// trip counts. Weights are copied from / to a dynamic MLP of the same shape;
+// the activations of the MLP are not checked, they're fixed by the Dense specs.
+template <size_t In, typename... Layers>
+struct StaticMLP
+{
+    static_assert(sizeof...(Layers) > 0, "StaticMLP needs at least one layer");
+
+    static constexpr size_t dim_in = In;
+    static constexpr size_t dim_out = detail::LayerChain<In, Layers...>::dim_out;
+    static constexpr size_t num_layers = sizeof...(Layers);
+
+    using input_type = std::array<double, dim_in>;
+    using output_type = std::array<double, dim_out>;
+
+    typename detail::LayerChain<In, Layers...>::type layers;
+
+    StaticMLP() = default;
+    explicit StaticMLP(const MLP &mlp) { load(mlp); }
+
+    const output_type &forward(const input_type &x) { return forwardImpl<0>(x); }
+
+    void backward(const output_type &y_grad) { backwardImpl<num_layers - 1>(y_grad); }
+
+    void zero_grad()
+    {
+        std::apply([](auto &...layer)
+                   { (layer.zero_grad(), ...); },
+                   layers);
+    }
+
+    void step(double learning_rate)
+    {
+        std::apply([learning_rate](auto &...layer)
+                   { (layer.step(learning_rate), ...); },
+                   layers);
+    }
+
+    void load(const MLP &mlp)
+    {
+        checkDepth(mlp);
+        loadImpl(mlp, std::make_index_sequence<num_layers>{});
+    }
+
+    void store(MLP &mlp) const
+    {
+        checkDepth(mlp);
+        storeImpl(mlp, std::make_index_sequence<num_layers>{});
+    }
+
+private:
+    template <size_t I, typename Input>
+    const output_type &forwardImpl(const Input &x)
+    {
+        const auto &y = std::get<I>(layers).forward(x);
+        if constexpr (I + 1 < num_layers)
+        {
+            return forwardImpl<I + 1>(y);
+        }
+        else
+        {
+            return y;
+        }
+    }
+
+    template <size_t I, typename Grad>
+    void backwardImpl(const Grad &y_grad)
+    {
+        if constexpr (I > 0)
+        {
+            const auto &x_grad = std::get<I>(layers).template backward<true>(y_grad);
+            backwardImpl<I - 1>(x_grad);
+        }
+        else
+        {
+            std::get<I>(layers).template backward<false>(y_grad);
+        }
+    }
+
+    static void checkDepth(const MLP &mlp)
+    {
+        if (mlp.layers.size() != num_layers)
+        {
+            throw std::invalid_argument("StaticMLP: number of layers doesn't match dynamic MLP");
+        }
+    }
+
+    template <size_t... I>
+    void loadImpl(const MLP &mlp, std::index_sequence<I...>)
+    {
+        (std::get<I>(layers).load(mlp.layers.at(I)), ...);
+    }
+
+    template <size_t... I>
+    void storeImpl(MLP &mlp, std::index_sequence<I...>) const
+    {
+        (std::get<I>(layers).store(mlp.layers.at(I)), ...);
+    }
+};
+
+// Softmax cross entropy on raw logits, writes dL/dlogits into grad and returns the loss
+template <size_t N>
+double crossEntropyLoss(const std::array<double, N> &logits, size_t truth, std::array<double, N> &grad)
+{
+    double logits_max = logits[0];
+    for (size_t i = 1; i < N; ++i)
+    {
+        logits_max = (logits[i] > logits_max) ? logits[i] : logits_max;
+    }
+
+    double sum = 0.0;
+    for (size_t i = 0; i < N; ++i)
+    {
+        grad[i] = std::exp(logits[i] - logits_max);
+        sum += grad[i];
+    }
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        grad[i] /= sum;
+    }
+    grad[truth] -= 1.0;
+
+    return -logits[truth] + logits_max + std::log(sum);
+}
@@ -0,0 +1,347 @@
+#include "sweep.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include "helper.h"
+#include "loss.h"
+
+Dataset::Dataset(const std::string &path, size_t context, double val_fraction, uint64_t seed) : context(context)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        throw std::runtime_error("Dataset: can't open " + path);
+    }
+
+    std::string n;
+    std::vector<std::string> names;
+    std::set<char> unique_chars;
+    while (getline(file, n))
+    {
+        names.emplace_back(n);
+        unique_chars.insert(n.begin(), n.end());
+    }
+
+    std::unordered_map<char, int> ctoi;
+    ctoi['.'] = 0;
+    int i = 1;
+    for (auto it = unique_chars.begin(); it != unique_chars.end(); ++it, ++i)
+    {
+        ctoi[*it] = i;
+    }
+    num_classes = unique_chars.size() + 1;
+
+    // Split by name so no validation window is also seen in training
+    std::mt19937_64 generator(seed);
+    std::shuffle(names.begin(), names.end(), generator);
+    size_t num_train = names.size() - static_cast<size_t>(val_fraction * names.size());
+
+    for (size_t k = 0; k < names.size(); ++k)
+    {
+        encodeName(names.at(k), ctoi, context, (k < num_train) ? train : val);
+    }
+}
+
+size_t Dataset::trainSize() const
+{
+    return train.size() / (context + 1);
+}
+
+size_t Dataset::valSize() const
+{
+    return val.size() / (context + 1);
+}
+
+std::vector<std::shared_ptr<Value>> Dataset::input(const int *example) const
+{
+    return encodeInput(example, context, num_classes);
+}
+
+std::vector<std::shared_ptr<Value>> Dataset::target(const int *example) const
+{
+    return one_hot(std::make_shared<Value>(example[context]), num_classes);
+}
+
+std::vector<SweepConfig> SweepSpace::grid() const
+{
+    std::vector<SweepConfig> configs;
+    for (const auto &w : widths)
+    {
+        // Without hidden layers the activation is never used, so emit those configs once
+        std::vector<std::string> used = w.empty() ? std::vector<std::string>{"id"} : activations;
+        for (const auto &a : used)
+        {
+            for (const auto &o : optimizers)
+            {
+                for (double lr : learning_rates)
+                {
+                    configs.push_back({w, a, o, lr});
+                }
+            }
+        }
+    }
+    return configs;
+}
+
+std::vector<SweepConfig> SweepSpace::random(size_t count, uint64_t seed) const
+{
+    if (widths.empty() || activations.empty() || optimizers.empty() || learning_rates.empty())
+    {
+        throw std::invalid_argument("SweepSpace: every dimension needs at least one value");
+    }
+
+    std::mt19937_64 generator(seed);
+    auto [lr_min, lr_max] = std::minmax_element(learning_rates.begin(), learning_rates.end());
+    std::uniform_real_distribution<double> log_lr(std::log(*lr_min), std::log(*lr_max));
+    auto pick = [&generator](size_t size)
+    { return std::uniform_int_distribution<size_t>(0, size - 1)(generator); };
+
+    std::vector<SweepConfig> configs;
+    configs.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        SweepConfig config;
+        config.widths = widths.at(pick(widths.size()));
+        config.activation = activations.at(pick(activations.size()));
+        if (config.widths.empty())
+        {
+            config.activation = "id";
+        }
+        config.optimizer = optimizers.at(pick(optimizers.size()));
+        config.learning_rate = std::exp(log_lr(generator));
+        configs.emplace_back(config);
+    }
+    return configs;
+}
+
+std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)> activationByName(const std::string &name)
+{
+    if (name == "id")
+    {
+        return id;
+    }
+    if (name == "relu")
+    {
+        return relu;
+    }
+    if (name == "tanh")
+    {
+        return ops::tanh;
+    }
+    if (name == "sigmoid")
+    {
+        return sigmoid;
+    }
+    if (name == "leakyRelu")
+    {
+        return [](const std::shared_ptr<Value> &value)
+        { return leakyRelu(value); };
+    }
+    throw std::invalid_argument("Unknown activation " + name);
+}
+
+std::unique_ptr<Optimizer> optimizerByName(const std::string &name, std::vector<std::shared_ptr<Value>> parameters, double learning_rate)
+{
+    if (name == "SGD")
+    {
+        return std::make_unique<SGD>(parameters, learning_rate);
+    }
+    if (name == "Nesterov")
+    {
+        return std::make_unique<Nesterov>(parameters, learning_rate, 0.0, 0.9);
+    }
+    if (name == "AdaGrad")
+    {
+        return std::make_unique<AdaGrad>(parameters, learning_rate);
+    }
+    if (name == "RMSProp")
+    {
+        return std::make_unique<RMSProp>(parameters, learning_rate);
+    }
+    if (name == "Adam")
+    {
+        return std::make_unique<Adam>(parameters, learning_rate);
+    }
+    throw std::invalid_argument("Unknown optimizer " + name);
+}
+
+namespace
+{
+    struct Job
+    {
+        SweepConfig config;
+        std::unique_ptr<MLP> mlp;
+        std::unique_ptr<Optimizer> optimizer;
+        std::mt19937_64 generator;
+        size_t steps = 0;
+        size_t rung = 0;
+        double val_loss = std::numeric_limits<double>::infinity();
+    };
+
+    void train(Job &job, const Dataset &dataset, size_t until, size_t batch_size)
+    {
+        std::uniform_int_distribution<size_t> sample(0, dataset.trainSize() - 1);
+        for (; job.steps < until; ++job.steps)
+        {
+            std::shared_ptr<Value> loss = std::make_shared<Value>(0.0);
+            for (size_t b = 0; b < batch_size; ++b)
+            {
+                const int *example = dataset.train.data() + sample(job.generator) * (dataset.context + 1);
+                loss = loss + crossEntropyLoss(job.mlp->forward(dataset.input(example)), dataset.target(example));
+            }
+            loss = loss / std::make_shared<Value>(batch_size);
+            job.mlp->zero_grad();
+            loss->backward();
+            job.optimizer->step();
+        }
+    }
+
+    double validate(Job &job, const Dataset &dataset, size_t val_samples)
+    {
+        size_t count = std::min(val_samples, dataset.valSize());
+        double total = 0.0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const int *example = dataset.val.data() + i * (dataset.context + 1);
+            total += crossEntropyLoss(job.mlp->forward(dataset.input(example)), dataset.target(example))->data;
+        }
+        double loss = total / count;
+        return std::isfinite(loss) ? loss : std::numeric_limits<double>::infinity();
+    }
+
+    std::string joinWidths(const std::vector<int> &widths)
+    {
+        std::string out;
+        for (size_t i = 0; i < widths.size(); ++i)
+        {
+            out += (i ? "-" : "") + std::to_string(widths.at(i));
+        }
+        return out;
+    }
+}
+
+std::vector<SweepResult> runSweep(const Dataset &dataset, const std::vector<SweepConfig> &configs, const SweepOptions &options)
+{
+    if (dataset.trainSize() == 0 || dataset.valSize() == 0)
+    {
+        throw std::invalid_argument("runSweep: dataset needs training and validation examples");
+    }
+
+    std::vector<Job> jobs(configs.size());
+    for (size_t i = 0; i < configs.size(); ++i)
+    {
+        Job &job = jobs.at(i);
+        job.config = configs.at(i);
+
+        std::vector<int> layers = job.config.widths;
+        layers.emplace_back(static_cast<int>(dataset.num_classes));
+        std::vector<std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)>> activations(layers.size() - 1, activationByName(job.config.activation));
+        activations.emplace_back(id);
+
+        Initializer initializer(options.seed, 1);
+        job.mlp = std::make_unique<MLP>(static_cast<int>(dataset.context * dataset.num_classes), layers, activations, initializer);
+        job.optimizer = optimizerByName(job.config.optimizer, job.mlp->parameters(), job.config.learning_rate);
+        job.generator.seed(options.seed + i);
+    }
+
+    size_t num_threads = options.num_threads ? options.num_threads : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<size_t> alive(jobs.size());
+    for (size_t i = 0; i < alive.size(); ++i)
+    {
+        alive.at(i) = i;
+    }
+
+    size_t budget = options.min_steps;
+    for (size_t rung = 0; rung < options.rungs && !alive.empty(); ++rung, budget *= options.eta)
+    {
+        std::atomic<size_t> next(0);
+        auto worker = [&]()
+        {
+            for (size_t k = next++; k < alive.size(); k = next++)
+            {
+                Job &job = jobs.at(alive.at(k));
+                train(job, dataset, budget, options.batch_size);
+                job.val_loss = validate(job, dataset, options.val_samples);
+                job.rung = rung;
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (size_t t = 0; t < std::min(num_threads, alive.size()); ++t)
+        {
+            pool.emplace_back(worker);
+        }
+        for (std::thread &thread : pool)
+        {
+            thread.join();
+        }
+
+        std::sort(alive.begin(), alive.end(), [&jobs](size_t a, size_t b)
+                  { return jobs.at(a).val_loss < jobs.at(b).val_loss; });
+        size_t keep = (alive.size() + options.eta - 1) / std::max<size_t>(options.eta, 1);
+        for (size_t k = keep; k < alive.size(); ++k)
+        {
+            // Stopped early, drop the model so memory is bounded by the survivors
+            jobs.at(alive.at(k)).optimizer.reset();
+            jobs.at(alive.at(k)).mlp.reset();
+        }
+        alive.resize(keep);
+    }
+
+    std::vector<SweepResult> results;
+    results.reserve(jobs.size());
+    for (const Job &job : jobs)
+    {
+        results.push_back({job.config, job.val_loss, job.steps, job.rung});
+    }
+    std::stable_sort(results.begin(), results.end(), [](const SweepResult &a, const SweepResult &b)
+                     { return a.rung != b.rung ? a.rung > b.rung : a.val_loss < b.val_loss; });
+    return results;
+}
+
+void writeCsv(const std::vector<SweepResult> &results, const std::string &path)
+{
+    std::ofstream file(path);
+    file << "rank,widths,activation,optimizer,learning_rate,rung,steps,val_loss\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const SweepResult &r = results.at(i);
+        file << i + 1 << ',' << joinWidths(r.config.widths) << ',' << r.config.activation << ',' << r.config.optimizer << ','
+             << r.config.learning_rate << ',' << r.rung << ',' << r.steps << ',' << r.val_loss << '\n';
+    }
+}
+
+void writeJson(const std::vector<SweepResult> &results, const std::string &path)
+{
+    std::ofstream file(path);
+    file << "[\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const SweepResult &r = results.at(i);
+        file << "  {\"rank\": " << i + 1 << ", \"widths\": [";
+        for (size_t w = 0; w < r.config.widths.size(); ++w)
+        {
+            file << (w ? ", " : "") << r.config.widths.at(w);
+        }
+        file << "], \"activation\": \"" << r.config.activation << "\", \"optimizer\": \"" << r.config.optimizer
+             << "\", \"learning_rate\": " << r.config.learning_rate << ", \"rung\": " << r.rung << ", \"steps\": " << r.steps
+             << ", \"val_loss\": ";
+        if (std::isfinite(r.val_loss))
+        {
+            file << r.val_loss;
+        }
+        else
+        {
+            file << "null";
+        }
+        file << (i + 1 < results.size() ? "},\n" : "}\n");
+    }
+    file << "]\n";
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "nn.h"
+#include "optimizer.h"
+
+// names.txt encoded once into read-only index arrays shared by every job
+struct Dataset
+{
+    size_t context;
+    size_t num_classes;
+    std::vector<int> train; // per example: context indices, then the target
+    std::vector<int> val;
+
+    Dataset(const std::string &path, size_t context = 2, double val_fraction = 0.1, uint64_t seed = 42);
+    size_t trainSize() const;
+    size_t valSize() const;
+    std::vector<std::shared_ptr<Value>> input(const int *example) const;
+    std::vector<std::shared_ptr<Value>> target(const int *example) const;
+};
+
+struct SweepConfig
+{
+    std::vector<int> widths; // hidden widths, the output layer is added
+    std::string activation;  // id, relu, tanh, leakyRelu, sigmoid; id without hidden layers
+    std::string optimizer;   // SGD, Nesterov, AdaGrad, RMSProp, Adam
+    double learning_rate;
+};
+
+struct SweepSpace
+{
+    std::vector<std::vector<int>> widths;
+    std::vector<std::string> activations;
+    std::vector<std::string> optimizers;
+    std::vector<double> learning_rates;
+
+    std::vector<SweepConfig> grid() const;
+    // Widths/activations/optimizers uniformly, learning rate log-uniformly between the extremes
+    std::vector<SweepConfig> random(size_t count, uint64_t seed = 42) const;
+};
+
+struct SweepResult
+{
+    SweepConfig config;
+    double val_loss;
+    size_t steps;
+    size_t rung; // successive halving round reached
+};
+
+// Successive halving: every surviving job trains until min_steps * eta^rung steps,
+// then only the best 1/eta by validation loss continue into the next rung.
+struct SweepOptions
+{
+    size_t min_steps = 10;
+    size_t eta = 3;
+    size_t rungs = 3;
+    size_t batch_size = 32;
+    size_t val_samples = 500;
+    size_t num_threads = 0; // 0 = hardware concurrency
+    uint64_t seed = 42;
+};
+
+std::function<std::shared_ptr<Value>(const std::shared_ptr<Value> &)> activationByName(const std::string &name);
+std::unique_ptr<Optimizer> optimizerByName(const std::string &name, std::vector<std::shared_ptr<Value>> parameters, double learning_rate);
+
+// Sorted best first: deepest rung, then lowest validation loss
+std::vector<SweepResult> runSweep(const Dataset &dataset, const std::vector<SweepConfig> &configs, const SweepOptions &options = {});
+
+void writeCsv(const std::vector<SweepResult> &results, const std::string &path);
+void writeJson(const std::vector<SweepResult> &results, const std::string &path);
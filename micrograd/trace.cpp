@@ -0,0 +1,117 @@
+#include "trace.h"
+#include <stdexcept>
+#include <unordered_map>
+#include "expr.h"
+
+Trace::Trace(const std::vector<std::shared_ptr<Value>> &parameters, size_t num_inputs, const std::function<std::vector<std::shared_ptr<Value>>(const std::vector<std::shared_ptr<Value>> &)> &model)
+    : parameters(parameters), num_inputs(num_inputs)
+{
+    std::vector<std::shared_ptr<Value>> inputs;
+    inputs.reserve(num_inputs);
+    for (size_t i = 0; i < num_inputs; ++i)
+    {
+        inputs.emplace_back(std::make_shared<Value>(0.0));
+    }
+
+    std::vector<std::shared_ptr<Value>> results;
+    {
+        expr::Unfused guard;
+        results = model(inputs);
+    }
+
+    std::unordered_set<std::shared_ptr<Value>> visited;
+    std::vector<std::shared_ptr<Value>> order;
+    for (const auto &result : results)
+    {
+        result->postDFS(result, visited, order);
+    }
+
+    std::unordered_map<const Value *, size_t> parameter_index;
+    for (size_t i = 0; i < parameters.size(); ++i)
+    {
+        parameter_index[parameters.at(i).get()] = i;
+    }
+    std::unordered_map<const Value *, size_t> input_index;
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        input_index[inputs.at(i).get()] = i;
+    }
+
+    std::unordered_map<const Value *, int> id;
+    nodes.reserve(order.size());
+    for (const auto &value : order)
+    {
+        if (value->op == Op::Fused)
+        {
+            throw std::invalid_argument("Trace: fused node in graph");
+        }
+
+        Node node = {value->op, value->param, -1, -1, Leaf::None, 0};
+        if (value->op == Op::Leaf)
+        {
+            if (parameter_index.count(value.get()))
+            {
+                node.leaf = Leaf::Parameter;
+                node.index = parameter_index.at(value.get());
+            }
+            else if (input_index.count(value.get()))
+            {
+                node.leaf = Leaf::Input;
+                node.index = input_index.at(value.get());
+            }
+            else
+            {
+                node.leaf = Leaf::Constant;
+                node.index = constants.size();
+                constants.emplace_back(value->data);
+            }
+        }
+        else
+        {
+            node.a = value->children.first ? id.at(value->children.first.get()) : -1;
+            node.b = value->children.second ? id.at(value->children.second.get()) : -1;
+        }
+
+        id[value.get()] = static_cast<int>(nodes.size());
+        nodes.emplace_back(node);
+    }
+
+    outputs.reserve(results.size());
+    for (const auto &result : results)
+    {
+        outputs.emplace_back(id.at(result.get()));
+    }
+}
+
+bool needsOperands(Op op)
+{
+    switch (op)
+    {
+    case Op::Mul:
+    case Op::Div:
+    case Op::Pow:
+    case Op::Max:
+    case Op::Min:
+    case Op::Log:
+    case Op::Relu:
+    case Op::LeakyRelu:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool needsOutput(Op op)
+{
+    switch (op)
+    {
+    case Op::Pow:
+    case Op::Exp:
+    case Op::Sqrt:
+    case Op::Tanh:
+    case Op::Sigmoid:
+        return true;
+    default:
+        return false;
+    }
+}
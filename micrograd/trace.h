@@ -0,0 +1,42 @@
+#pragma once
+#include <functional>
+#include <memory>
+#include <vector>
+#include "value.h"
+
+// A graph recorded once from real ops and kept as plain data: nodes in topological order,
+// leaves classified as model parameters, per-run inputs or constants baked at trace time.
+// Only valid while the model's graph shape doesn't depend on the data.
+struct Trace
+{
+    enum class Leaf : uint8_t
+    {
+        None,
+        Parameter,
+        Input,
+        Constant
+    };
+
+    struct Node
+    {
+        Op op;
+        double param;
+        int a;      // operand node ids, -1 if unused
+        int b;
+        Leaf leaf;
+        size_t index; // into parameters, inputs or constants for leaves
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> outputs;
+    std::vector<std::shared_ptr<Value>> parameters;
+    std::vector<double> constants;
+    size_t num_inputs;
+
+    // Runs model once on num_inputs fresh leaves with fusion disabled and records the graph
+    Trace(const std::vector<std::shared_ptr<Value>> &parameters, size_t num_inputs, const std::function<std::vector<std::shared_ptr<Value>>(const std::vector<std::shared_ptr<Value>> &)> &model);
+};
+
+// Whether the backward of op reads its operand values / its own output value
+bool needsOperands(Op op);
+bool needsOutput(Op op);
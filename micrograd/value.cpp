@@ -1,7 +1,7 @@
 #include "value.h"
 #include <iostream>
 
-Value::Value(double data) : data{data}, grad{0.0}, children({nullptr, nullptr}) {}
+Value::Value(double data) : data{data}, grad{0.0}, children({nullptr, nullptr}), operands{nullptr}, num_operands{0}, op{Op::Leaf}, param{0.0}, fused_backward{nullptr} {}
 
 void Value::postDFS(
     const std::shared_ptr<Value> &current,
@@ -19,6 +19,10 @@ void Value::postDFS(
         {
             postDFS(current->children.second, visited, result);
         }
+        for (size_t i = 0; i < current->num_operands; ++i)
+        {
+            postDFS(current->operands[i], visited, result);
+        }
         result.emplace_back(current);
     }
 }
@@ -37,5 +41,9 @@ void Value::backward()
         {
             result.at(i)->_backward();
         }
+        else if (result.at(i)->fused_backward)
+        {
+            result.at(i)->fused_backward(*result.at(i));
+        }
     }
 }
\ No newline at end of file
@@ -1,9 +1,35 @@
 #pragma once
+#include <cstdint>
 #include <tuple>
 #include <memory>
 #include <functional>
 #include <stack>
 #include <unordered_set>
+#include <vector>
+
+// Operation that produced a Value, lets a traced graph be replayed without its closures
+enum class Op : uint8_t
+{
+    Leaf,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Pow,
+    Max,
+    Min,
+    Pos,
+    Neg,
+    Exp,
+    Sqrt,
+    Log,
+    Id,
+    Tanh,
+    Relu,
+    Sigmoid,
+    LeakyRelu,
+    Fused
+};
 
 struct Value : public std::enable_shared_from_this<Value>
 {
@@ -11,6 +37,11 @@ struct Value : public std::enable_shared_from_this<Value>
     double grad;
     double grad2;
     std::pair<std::shared_ptr<Value>, std::shared_ptr<Value>> children;
+    // Inputs of fused nodes, stored inside the node itself
+    const std::shared_ptr<Value> *operands;
+    size_t num_operands;
+    Op op;
+    double param; // alpha of LeakyRelu
     Value(double data);
     void postDFS(
         const std::shared_ptr<Value> &current,
@@ -18,4 +49,6 @@ struct Value : public std::enable_shared_from_this<Value>
         std::vector<std::shared_ptr<Value>> &result);
     void backward();
     std::function<void()> _backward;
+    // Backward of fused nodes, which are never wrapped in a std::function
+    void (*fused_backward)(Value &);
 };
\ No newline at end of file